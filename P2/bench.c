@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "constants.h"
+#include "ctf_cipher.h"
+
+/*
+ *  <----! CTF cipher benchmark ---->
+ *
+ *	  bench [trace] [operations]
+ *		Replays the mystery() calls of a trace, the ctf_mystery lines
+ *		of /sys/kernel/tracing/trace for one open file, through
+ *		ctf_update_value() and through the product tables the module
+ *		uses, and reports the operations per second of each.  Without
+ *		a trace it replays a random one.  The trace is repeated until
+ *		@operations (100000000 by default) calls have run.
+ */
+
+enum {
+	OP_READ,
+	OP_WRITE,
+	OP_IOC_CMD,
+	OP_IOC_ARG,
+	OP_SEEK_SET,
+	OP_SEEK_CUR,
+	OP_SEEK_END,
+	NR_OPS,
+};
+
+static const __u8 secrets[NR_OPS][2] = {
+	[OP_READ] = { READ_MSECRET, READ_DSECRET },
+	[OP_WRITE] = { WRITE_MSECRET, WRITE_DSECRET },
+	[OP_IOC_CMD] = { IOC_CMD_MSECRET, IOC_CMD_DSECRET },
+	[OP_IOC_ARG] = { IOC_ARG_MSECRET, IOC_ARG_DSECRET },
+	[OP_SEEK_SET] = { SEEK_SET_MSECRET, SEEK_SET_DSECRET },
+	[OP_SEEK_CUR] = { SEEK_CUR_MSECRET, SEEK_CUR_DSECRET },
+	[OP_SEEK_END] = { SEEK_END_MSECRET, SEEK_END_DSECRET },
+};
+
+static struct ctf_op ops[NR_OPS];
+
+struct step {
+	__u8 op;
+	__u8 operation;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void apply(const struct step *step, __u8 *message_val, __u8 *decode_val)
+{
+	ctf_op_update(&ops[step->op], step->operation, message_val, decode_val);
+}
+
+/*
+ * The trace names seeks "seek1" and "seek2" whatever their whence, which
+ * is told apart by the values each one leaves.  Returns the number of
+ * steps, or -1 if the file cannot be read.  Events are checked against
+ * the values they recorded, starting from the initial secrets.
+ */
+static long load_trace(const char *path, struct step **trace)
+{
+	FILE *file = fopen(path, "r");
+	__u8 message_val = INIT_MSECRET, decode_val = INIT_DSECRET;
+	size_t size = 0;
+	long n = 0, wrong = 0;
+	char line[512];
+
+	if (!file) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), file)) {
+		const char *event = strstr(line, "ctf_mystery: ");
+		unsigned int decode, operation, message;
+		char func[8];
+
+		if (!event ||
+		    sscanf(event, "ctf_mystery: Mystery called by %7s updated "
+			   "value to %u operation=%u message=%u", func, &decode,
+			   &operation, &message) != 4)
+			continue;
+
+		if ((size_t)n == size) {
+			size = size ? 2 * size : 1024;
+			*trace = realloc(*trace, size * sizeof(**trace));
+			if (!*trace) {
+				perror("realloc");
+				exit(1);
+			}
+		}
+
+		struct step *step = &(*trace)[n++];
+
+		step->operation = operation;
+		if (!strcmp(func, "read"))
+			step->op = OP_READ;
+		else if (!strcmp(func, "write"))
+			step->op = OP_WRITE;
+		else if (!strcmp(func, "ioctl1"))
+			step->op = OP_IOC_CMD;
+		else if (!strcmp(func, "ioctl2"))
+			step->op = OP_IOC_ARG;
+		else
+			step->op = OP_SEEK_SET;
+
+		for (int op = OP_SEEK_SET; !strncmp(func, "seek", 4) &&
+					   op <= OP_SEEK_END; ++op) {
+			__u8 m = message_val, d = decode_val;
+
+			ctf_op_update(&ops[op], operation, &m, &d);
+			if (m == message && d == decode)
+				step->op = op;
+		}
+		apply(step, &message_val, &decode_val);
+		wrong += message_val != message || decode_val != decode;
+	}
+
+	fclose(file);
+	if (wrong)
+		fprintf(stderr, "%ld events do not replay, is the trace from "
+			"one file?\n", wrong);
+	return n;
+}
+
+static long random_trace(struct step **trace)
+{
+	const long n = 4096;
+
+	*trace = malloc(n * sizeof(**trace));
+	if (!*trace) {
+		perror("malloc");
+		exit(1);
+	}
+
+	srand(1);
+	for (long i = 0; i < n; ++i) {
+		(*trace)[i].op = rand() % NR_OPS;
+		(*trace)[i].operation = rand();
+	}
+	return n;
+}
+
+// The final values, so that the replay cannot be optimized away.
+static unsigned int replay_modulo(const struct step *trace, long n,
+				  long operations)
+{
+	__u8 message_val = INIT_MSECRET, decode_val = INIT_DSECRET;
+
+	for (long done = 0; done < operations; done += n) {
+		for (long i = 0; i < n; ++i) {
+			const __u8 *secret = secrets[trace[i].op];
+
+			message_val = ctf_update_value(message_val, secret[0],
+						       trace[i].operation);
+			decode_val = ctf_update_value(decode_val, secret[1],
+						      trace[i].operation);
+		}
+	}
+	return message_val << 8 | decode_val;
+}
+
+static unsigned int replay_tables(const struct step *trace, long n,
+				  long operations)
+{
+	__u8 message_val = INIT_MSECRET, decode_val = INIT_DSECRET;
+
+	for (long done = 0; done < operations; done += n)
+		for (long i = 0; i < n; ++i)
+			apply(&trace[i], &message_val, &decode_val);
+	return message_val << 8 | decode_val;
+}
+
+int main(int argc, char **argv)
+{
+	long operations = argc > 2 ? atol(argv[2]) : 100000000;
+	struct step *trace = NULL;
+	long n;
+
+	for (int op = 0; op < NR_OPS; ++op)
+		ctf_op_init(&ops[op], secrets[op][0], secrets[op][1]);
+
+	n = argc > 1 ? load_trace(argv[1], &trace) : random_trace(&trace);
+	if (n <= 0) {
+		fprintf(stderr, "no ctf_mystery events to replay\n");
+		return 1;
+	}
+	// Whole passes over the trace.
+	operations = (operations + n - 1) / n * n;
+
+	double start = now();
+	unsigned int modulo = replay_modulo(trace, n, operations);
+	double modulo_time = now() - start;
+
+	start = now();
+	unsigned int tables = replay_tables(trace, n, operations);
+	double tables_time = now() - start;
+
+	free(trace);
+	if (modulo != tables) {
+		fprintf(stderr, "the tables disagree with update_value()\n");
+		return 1;
+	}
+
+	printf("%ld operations in the trace, %ld replayed\n", n, operations);
+	printf("update_value	%.0f ops/s\n", operations / modulo_time);
+	printf("tables		%.0f ops/s	%.2fx\n", operations / tables_time,
+	       modulo_time / tables_time);
+	return 0;
+}
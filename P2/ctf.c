@@ -5,36 +5,52 @@
 #include <linux/cdev.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
+#include <linux/uaccess.h>
 #include "constants.h"
+#include "ctf.h"
+#include "ctf_cipher.h"
+
+#define CREATE_TRACE_POINTS
+#include "ctf_trace.h"
 
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 MODULE_LICENSE("GPL");
 
+static bool log_mystery;
+module_param(log_mystery, bool, 0644);
+MODULE_PARM_DESC(log_mystery, "Also log every mystery() call to the kernel log, ratelimited");
+
 static dev_t ctf_dev;
 static struct cdev *ctf_cdev;
 static struct class *ctf_class;
 static const u8 bytes[] = { SECRET_MESSAGE };
 
+/* Device-wide configuration, kept as the device's drvdata */
+struct ctf_config
+{
+	u8 init_message_val, init_decode_val;
+};
+
+/* Decoder state, one per open file */
 struct ctf
 {
+	struct mutex lock;
 	size_t index;
 	u8 message_val, decode_val;
+	bool stream;
 };
 
-static u8 update_value(u8 val, u8 x, u8 y)
-{
-	u32 factor1 = 1 + (u32)val;
-	u32 factor2 = 1 + (u32)x;
-	u32 product = (factor1 * factor2) % 257;
-	return y ^ (u8)product;
-}
+/* Filled from constants.h at init, one per operation */
+static struct ctf_op read_op, write_op, ioc_cmd_op, ioc_arg_op;
+static struct ctf_op seek_set_op, seek_cur_op, seek_end_op;
 
-static void mystery(const char *func_name, struct ctf *ctf, u8 operation_secret, u8 message_secret, u8 decode_secret)
+static void mystery(const char *func_name, struct ctf *ctf, u8 operation_secret, const struct ctf_op *op)
 {
-	ctf->message_val = update_value(ctf->message_val, message_secret, operation_secret);
-	ctf->decode_val = update_value(ctf->decode_val, decode_secret, operation_secret);
-	pr_info("Mystery called by %s updated value to %hhu\n", func_name, ctf->decode_val);
+	ctf_op_update(op, operation_secret, &ctf->message_val, &ctf->decode_val);
+	trace_ctf_mystery(func_name, operation_secret, ctf->message_val, ctf->decode_val);
+	if (log_mystery)
+		pr_info_ratelimited("Mystery called by %s updated value to %hhu\n", func_name, ctf->decode_val);
 }
 
 static u8 get_message_byte(struct ctf *ctf)
@@ -49,76 +65,148 @@ static u8 get_message_byte(struct ctf *ctf)
 static int ctf_open(struct inode *inode, struct file *file)
 {
 	struct device *ctf_device = class_find_device_by_devt(ctf_class, ctf_dev);
-	struct ctf *ctf = dev_get_drvdata(ctf_device);
-	ctf->index = 0;
-	ctf->message_val = INIT_MSECRET;
-	ctf->decode_val = INIT_DSECRET;
+	struct ctf_config *config;
+	struct ctf *ctf;
+	if (!ctf_device)
+		return -ENODEV;
+	ctf = kzalloc(sizeof(*ctf), GFP_KERNEL);
+	if (!ctf) {
+		put_device(ctf_device);
+		return -ENOMEM;
+	}
+	config = dev_get_drvdata(ctf_device);
+	mutex_init(&ctf->lock);
+	ctf->message_val = config->init_message_val;
+	ctf->decode_val = config->init_decode_val;
+	put_device(ctf_device);
 	file->private_data = ctf;
 	return 0;
 }
 
 static int ctf_release(struct inode *inode, struct file *file)
 {
+	struct ctf *ctf = file->private_data;
+	mutex_destroy(&ctf->lock);
+	kfree(ctf);
 	return 0;
 }
 
+/*
+ * One byte per read of one byte, copied out with a single copy_to_user().
+ * The state is left as it was if that fails.
+ */
+static ssize_t ctf_read_stream(struct ctf *ctf, char __user *data, size_t count, loff_t *f_pos)
+{
+	size_t index = ctf->index;
+	u8 message_val = ctf->message_val, decode_val = ctf->decode_val;
+	loff_t pos = *f_pos;
+	u8 buf[256];
+	size_t i;
+	for (i = 0; i < count; i++) {
+		++pos;
+		mystery("read", ctf, (u8)pos, &read_op);
+		buf[i] = get_message_byte(ctf);
+	}
+	if (copy_to_user(data, buf, count)) {
+		ctf->index = index;
+		ctf->message_val = message_val;
+		ctf->decode_val = decode_val;
+		return -EFAULT;
+	}
+	*f_pos = pos;
+	return count;
+}
+
 static ssize_t ctf_read(struct file *file, char __user *data, size_t count, loff_t *f_pos)
 {
 	struct ctf *ctf = file->private_data;
-	if(count > 256 || *f_pos + count > 256)
-		return -EIO;
-	*f_pos += count;
-	mystery("read", ctf, (u8)*f_pos, READ_MSECRET, READ_DSECRET);
-	return (ssize_t)get_message_byte(ctf);
+	ssize_t ret;
+	mutex_lock(&ctf->lock);
+	if(count > 256 || *f_pos + count > 256) {
+		ret = -EIO;
+	} else if (ctf->stream) {
+		ret = ctf_read_stream(ctf, data, count, f_pos);
+	} else {
+		*f_pos += count;
+		mystery("read", ctf, (u8)*f_pos, &read_op);
+		ret = get_message_byte(ctf);
+	}
+	mutex_unlock(&ctf->lock);
+	return ret;
 }
 
 static ssize_t ctf_write(struct file *file, const char __user *data, size_t count, loff_t *f_pos)
 {
 	struct ctf *ctf = file->private_data;
-	if(count > 256 || *f_pos + count > 256)
-		return -EIO;
+	ssize_t ret;
+	mutex_lock(&ctf->lock);
+	if(count > 256 || *f_pos + count > 256) {
+		ret = -EIO;
+		goto out;
+	}
 	*f_pos += count;
-	mystery("write", ctf, (u8)*f_pos, WRITE_MSECRET, WRITE_DSECRET);
-	return (ssize_t)get_message_byte(ctf);
+	mystery("write", ctf, (u8)*f_pos, &write_op);
+	ret = get_message_byte(ctf);
+out:
+	mutex_unlock(&ctf->lock);
+	return ret;
 }
 
 static long ctf_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct ctf *ctf = file->private_data;
-	mystery("ioctl1", ctf, (u8)cmd, IOC_CMD_MSECRET, IOC_CMD_DSECRET);
-	mystery("ioctl2", ctf, (u8)arg, IOC_ARG_MSECRET, IOC_ARG_DSECRET);
-	return (long)get_message_byte(ctf);
+	long ret;
+	if (cmd == CTF_STREAM) {
+		if (arg > 1)
+			return -EINVAL;
+		mutex_lock(&ctf->lock);
+		ctf->stream = arg;
+		mutex_unlock(&ctf->lock);
+		return 0;
+	}
+	mutex_lock(&ctf->lock);
+	mystery("ioctl1", ctf, (u8)cmd, &ioc_cmd_op);
+	mystery("ioctl2", ctf, (u8)arg, &ioc_arg_op);
+	ret = get_message_byte(ctf);
+	mutex_unlock(&ctf->lock);
+	return ret;
 }
 
 static loff_t ctf_llseek(struct file *file, loff_t off, int whence)
 {
 	struct ctf *ctf = file->private_data;
-	u8 msecret, dsecret;
-	loff_t base;
+	const struct ctf_op *op;
+	loff_t base, ret;
+	mutex_lock(&ctf->lock);
 	switch(whence)
 	{
 	case SEEK_SET:
 		base = 0;
-		msecret = SEEK_SET_MSECRET;
-		dsecret = SEEK_SET_DSECRET;
+		op = &seek_set_op;
 		break;
 	case SEEK_CUR:
 		base = file->f_pos;
-		msecret = SEEK_CUR_MSECRET;
-		dsecret = SEEK_CUR_DSECRET;
+		op = &seek_cur_op;
 		break;
 	case SEEK_END:
 		base = 256;
-		msecret = SEEK_END_MSECRET;
-		dsecret = SEEK_END_DSECRET;
+		op = &seek_end_op;
 		break;
+	default:
+		ret = -EINVAL;
+		goto out;
 	}
-	if(base + off < 0 || 256 < base + off)
-		return -EINVAL;
-	mystery("seek1", ctf, (u8)file->f_pos, msecret, dsecret);
+	if(base + off < 0 || 256 < base + off) {
+		ret = -EINVAL;
+		goto out;
+	}
+	mystery("seek1", ctf, (u8)file->f_pos, op);
 	file->f_pos = base + off;
-	mystery("seek2", ctf, (u8)file->f_pos, msecret, dsecret);
-	return (loff_t)get_message_byte(ctf);
+	mystery("seek2", ctf, (u8)file->f_pos, op);
+	ret = get_message_byte(ctf);
+out:
+	mutex_unlock(&ctf->lock);
+	return ret;
 }
 
 
@@ -142,7 +230,7 @@ static char *ctf_node(const struct device *dev, umode_t *mode)
 static int ctf_init(void)
 {
 	struct device *ctf_device;
-	struct ctf *ctf;
+	struct ctf_config *config;
 	int ret = alloc_chrdev_region(&ctf_dev, 0, 1, "ctf");
 	if (ret < 0) {
 		pr_err("init: unnable to allocate region %i\n", ret);
@@ -173,14 +261,24 @@ static int ctf_init(void)
 
 	ctf_class->devnode = ctf_node;
 
-	ctf = kzalloc(sizeof(*ctf), GFP_KERNEL);
-	if (!ctf) {
+	ctf_op_init(&read_op, READ_MSECRET, READ_DSECRET);
+	ctf_op_init(&write_op, WRITE_MSECRET, WRITE_DSECRET);
+	ctf_op_init(&ioc_cmd_op, IOC_CMD_MSECRET, IOC_CMD_DSECRET);
+	ctf_op_init(&ioc_arg_op, IOC_ARG_MSECRET, IOC_ARG_DSECRET);
+	ctf_op_init(&seek_set_op, SEEK_SET_MSECRET, SEEK_SET_DSECRET);
+	ctf_op_init(&seek_cur_op, SEEK_CUR_MSECRET, SEEK_CUR_DSECRET);
+	ctf_op_init(&seek_end_op, SEEK_END_MSECRET, SEEK_END_DSECRET);
+
+	config = kzalloc(sizeof(*config), GFP_KERNEL);
+	if (!config) {
 		ret = -ENOMEM;
-		pr_err("init: failed to allocate ctf struct %i\n", ret);
+		pr_err("init: failed to allocate ctf config %i\n", ret);
 		goto fail_class;
 	}
+	config->init_message_val = INIT_MSECRET;
+	config->init_decode_val = INIT_DSECRET;
 
-	ctf_device = device_create(ctf_class, NULL, ctf_dev, ctf, "ctf");
+	ctf_device = device_create(ctf_class, NULL, ctf_dev, config, "ctf");
 	if (IS_ERR(ctf_device)) {
 		ret = PTR_ERR(ctf_device);
 		pr_err("init: unable to create device %i\n", ret);
@@ -192,7 +290,7 @@ static int ctf_init(void)
 	return 0;
 
 fail_device:
-	kfree(ctf);
+	kfree(config);
 fail_class:
 	class_destroy(ctf_class);
 fail_add:
@@ -206,9 +304,10 @@ fail_region:
 static void ctf_exit(void)
 {
 	struct device *ctf_device = class_find_device_by_devt(ctf_class, ctf_dev);
-	struct ctf *ctf = dev_get_drvdata(ctf_device);
+	struct ctf_config *config = dev_get_drvdata(ctf_device);
 	pr_info("exit called\n");
-	kfree(ctf);
+	put_device(ctf_device);
+	kfree(config);
 	device_destroy(ctf_class, ctf_dev);
 	class_destroy(ctf_class);
 	cdev_del(ctf_cdev);
@@ -0,0 +1,21 @@
+#ifndef CTF_H
+#define CTF_H
+
+#ifdef __KERNEL__
+#include <linux/ioctl.h>
+#else /* userspace */
+#include <sys/ioctl.h>
+#endif
+
+#define CTF_MAGIC ('c')
+
+/*
+ * Selects what read(2) does on the file.  By default it runs the cipher
+ * once and returns the decoded byte.  With CTF_STREAM set to 1, a read of
+ * count bytes runs it count times, as count reads of one byte would, and
+ * copies the decoded bytes to the buffer.  This command does not run the
+ * cipher; every other ioctl(2) does.
+ */
+#define CTF_STREAM _IOW(CTF_MAGIC, 0x01, int)
+
+#endif  // CTF_H
@@ -0,0 +1,41 @@
+#ifndef CTF_CIPHER_H
+#define CTF_CIPHER_H
+
+#include <linux/types.h>
+
+/*
+ * The cipher behind mystery(), shared by the module and the userspace
+ * tools.  Every operation mixes its byte into message_val and decode_val
+ * through (1 + value) * (1 + secret) % 257, each value with its own secret
+ * from constants.h.
+ */
+static inline __u8 ctf_update_value(__u8 val, __u8 x, __u8 y)
+{
+	__u32 factor1 = 1 + (__u32)val;
+	__u32 factor2 = 1 + (__u32)x;
+	__u32 product = (factor1 * factor2) % 257;
+	return y ^ (__u8)product;
+}
+
+/* The products of one operation's secrets with every value */
+struct ctf_op
+{
+	__u8 message[256], decode[256];
+};
+
+static inline void ctf_op_init(struct ctf_op *op, __u8 message_secret, __u8 decode_secret)
+{
+	for (unsigned int val = 0; val < 256; val++) {
+		op->message[val] = ctf_update_value(val, message_secret, 0);
+		op->decode[val] = ctf_update_value(val, decode_secret, 0);
+	}
+}
+
+/* ctf_update_value() for both values, one load each */
+static inline void ctf_op_update(const struct ctf_op *op, __u8 operation, __u8 *message_val, __u8 *decode_val)
+{
+	*message_val = operation ^ op->message[*message_val];
+	*decode_val = operation ^ op->decode[*decode_val];
+}
+
+#endif  // CTF_CIPHER_H
@@ -0,0 +1,47 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ctf
+
+#if !defined(CTF_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define CTF_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * Starts like the line mystery() used to printk, so the dmesg logs can be
+ * rebuilt from /sys/kernel/tracing/trace with
+ *
+ *	sed -n 's/.*ctf_mystery: \(.*\) operation=.*$/ctf: \1/p'
+ */
+TRACE_EVENT(ctf_mystery,
+
+	TP_PROTO(const char *func, u8 operation, u8 message_val, u8 decode_val),
+
+	TP_ARGS(func, operation, message_val, decode_val),
+
+	TP_STRUCT__entry(
+		__array(char, func, 8)
+		__field(u8, operation)
+		__field(u8, message_val)
+		__field(u8, decode_val)
+	),
+
+	TP_fast_assign(
+		strscpy(__entry->func, func, sizeof(__entry->func));
+		__entry->operation = operation;
+		__entry->message_val = message_val;
+		__entry->decode_val = decode_val;
+	),
+
+	TP_printk("Mystery called by %s updated value to %u "
+		  "operation=%u message=%u", __entry->func, __entry->decode_val,
+		  __entry->operation, __entry->message_val)
+);
+
+#endif /* CTF_TRACE_H */
+
+/* This part must be outside the include guard */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ctf_trace
+#include <trace/define_trace.h>
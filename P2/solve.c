@@ -0,0 +1,486 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "ctf_cipher.h"
+
+/*
+ *  <----! CTF solver ---->
+ *
+ *	  solve [-l log] [-m message]
+ *		Finds the syscalls on a new file that reproduce the mystery()
+ *		calls of a kernel log (dmesg or the ctf_mystery trace lines),
+ *		that make the returned bytes spell a message, or both, and
+ *		prints them along with the bytes they return.
+ *
+ *	The search runs offline on a model of the module built from the same
+ *	constants.h.  Every successful syscall returns one byte, so a script
+ *	has one syscall per logged call or message byte; the search goes
+ *	breadth first, one syscall per layer, over the (message_val,
+ *	decode_val, file position) states and keeps the first way each state
+ *	is reached.  Every layer is expanded by all the CPUs.
+ */
+
+#define NR_STATES (256 * 256 * 257)
+#define MAX_STEPS (1024)
+
+enum call_kind { CALL_READ, CALL_WRITE, CALL_IOCTL, CALL_LSEEK, NR_CALLS };
+
+static const char *const call_names[NR_CALLS] = { "read", "write", "ioctl",
+						  "lseek" };
+
+static const __u8 bytes[] = { SECRET_MESSAGE };
+
+/* Tables as in the module, seek_ops by whence */
+static struct ctf_op read_op, write_op, ioc_cmd_op, ioc_arg_op, seek_ops[3];
+
+struct call {
+	__u8 kind;
+	__u8 whence;
+	__s16 a;	/* count, (u8)cmd or offset */
+	__u8 b;		/* (u8)arg */
+};
+
+/* What a layer must match, -1 where anything goes */
+struct step {
+	int kind;
+	int decode[2];	/* decode_val after each mystery() of the call */
+	int message;	/* message_val after the call */
+	int free_decode;	/* no step from this one on pins decode_val */
+};
+
+struct node {
+	__u32 state;
+	__u32 parent;	/* index in the previous layer */
+	struct call call;
+};
+
+struct layer {
+	struct node *nodes;
+	size_t len, size;
+};
+
+static struct step steps[MAX_STEPS];
+static int nr_steps;
+
+// States reached in the layer being built, claimed with an atomic or.
+static __u64 seen[(NR_STATES + 63) / 64];
+
+static __u32 pack(__u8 message_val, __u8 decode_val, unsigned int pos)
+{
+	return (message_val << 8 | decode_val) * 257 + pos;
+}
+
+/*
+ * States that differ only in decode_val have the same futures once nothing
+ * pins it anymore, so they are kept once.
+ */
+static __u32 memo_key(const struct step *step, __u32 state)
+{
+	return step->free_decode ? state - state / 257 % 256 * 257 : state;
+}
+
+static void unpack(__u32 state, __u8 *message_val, __u8 *decode_val,
+		   unsigned int *pos)
+{
+	*pos = state % 257;
+	*decode_val = state / 257;
+	*message_val = state / 257 >> 8;
+}
+
+static void push(struct layer *layer, const struct node *node)
+{
+	if (layer->len == layer->size) {
+		layer->size = layer->size ? 2 * layer->size : 256;
+		layer->nodes = realloc(layer->nodes,
+				       layer->size * sizeof(*layer->nodes));
+		if (!layer->nodes) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	layer->nodes[layer->len++] = *node;
+}
+
+static int matches(int pin, __u8 val)
+{
+	return pin < 0 || pin == val;
+}
+
+static void visit(struct layer *out, const struct step *step, __u32 parent,
+		  __u8 message_val, __u8 decode_val, unsigned int pos,
+		  struct call call)
+{
+	if (!matches(step->message, message_val))
+		return;
+
+	__u32 state = pack(message_val, decode_val, pos);
+	__u32 key = memo_key(step, state);
+	__u64 bit = 1ULL << (key % 64);
+
+	if (__atomic_fetch_or(&seen[key / 64], bit, __ATOMIC_RELAXED) & bit)
+		return;
+
+	struct node node = { .state = state, .parent = parent, .call = call };
+
+	push(out, &node);
+}
+
+/*
+ * The operation byte that takes the values to their pins, -1 with no pin and
+ * -2 when the pins disagree.  @message and @decode are the products the
+ * byte is xored with.
+ */
+static int pinned_op(int message_pin, __u8 message, int decode_pin,
+		     __u8 decode)
+{
+	int op = message_pin >= 0 ? message_pin ^ message : -1;
+
+	if (decode_pin >= 0 && op >= 0 && op != (decode_pin ^ decode))
+		return -2;
+	return decode_pin >= 0 ? decode_pin ^ decode : op;
+}
+
+/* Every call from @node's state that @step allows. */
+static void expand(struct layer *out, const struct step *step,
+		   const struct node *node, __u32 index)
+{
+	__u8 m0, d0;
+	unsigned int pos;
+
+	unpack(node->state, &m0, &d0, &pos);
+
+	for (int kind = 0; kind < NR_CALLS; ++kind) {
+		if (step->kind >= 0 && step->kind != kind)
+			continue;
+
+		if (kind == CALL_READ || kind == CALL_WRITE) {
+			const struct ctf_op *op = kind == CALL_READ ? &read_op :
+								      &write_op;
+
+			int want = pinned_op(step->message, op->message[m0],
+					     step->decode[0], op->decode[d0]);
+
+			// The position moves by the count before mystery().
+			for (unsigned int next = pos; next <= 256; ++next) {
+				__u8 m = m0, d = d0;
+
+				if (want != -1 && want != (__u8)next)
+					continue;
+				struct call call = { .kind = kind,
+						     .a = next - pos };
+
+				ctf_op_update(op, next, &m, &d);
+				if (matches(step->decode[0], d))
+					visit(out, step, index, m, d, next, call);
+			}
+		} else if (kind == CALL_IOCTL) {
+			for (unsigned int cmd = 0; cmd < 256; ++cmd) {
+				__u8 m1 = m0, d1 = d0;
+
+				ctf_op_update(&ioc_cmd_op, cmd, &m1, &d1);
+				if (!matches(step->decode[0], d1))
+					continue;
+
+				// A pinned value leaves one arg to try.
+				unsigned int first = 0, last = 255;
+
+				if (step->message >= 0)
+					first = last = step->message ^
+						       ioc_arg_op.message[m1];
+				else if (step->decode[1] >= 0)
+					first = last = step->decode[1] ^
+						       ioc_arg_op.decode[d1];
+
+				for (unsigned int arg = first; arg <= last; ++arg) {
+					__u8 m = m1, d = d1;
+					struct call call = { .kind = kind,
+							     .a = cmd, .b = arg };
+
+					ctf_op_update(&ioc_arg_op, arg, &m, &d);
+					if (matches(step->decode[1], d))
+						visit(out, step, index, m, d,
+						      pos, call);
+				}
+			}
+		} else {
+			for (int whence = 0; whence < 3; ++whence) {
+				const struct ctf_op *op = &seek_ops[whence];
+				int base = whence == SEEK_SET ? 0 :
+					   whence == SEEK_CUR ? (int)pos : 256;
+				__u8 m1 = m0, d1 = d0;
+
+				ctf_op_update(op, pos, &m1, &d1);
+				if (!matches(step->decode[0], d1))
+					continue;
+
+				int want = pinned_op(step->message, op->message[m1],
+						     step->decode[1],
+						     op->decode[d1]);
+
+				for (unsigned int next = 0; next <= 256; ++next) {
+					__u8 m = m1, d = d1;
+
+					if (want != -1 && want != (__u8)next)
+						continue;
+					struct call call = { .kind = kind,
+							     .whence = whence,
+							     .a = next - base };
+
+					ctf_op_update(op, next, &m, &d);
+					if (matches(step->decode[1], d))
+						visit(out, step, index, m, d,
+						      next, call);
+				}
+			}
+		}
+	}
+}
+
+struct worker {
+	pthread_t thread;
+	const struct layer *in;
+	const struct step *step;
+	size_t first, last;
+	struct layer out;
+};
+
+static void *expand_range(void *arg)
+{
+	struct worker *w = arg;
+
+	w->out.len = 0;
+	for (size_t i = w->first; i < w->last; ++i)
+		expand(&w->out, w->step, &w->in->nodes[i], i);
+	return NULL;
+}
+
+/* The next layer from @in, its states claimed by whichever worker wins. */
+static void expand_layer(const struct layer *in, struct layer *out,
+			 const struct step *step, struct worker *workers,
+			 int nr_workers)
+{
+	for (int t = 0; t < nr_workers; ++t) {
+		workers[t].in = in;
+		workers[t].step = step;
+		workers[t].first = in->len * t / nr_workers;
+		workers[t].last = in->len * (t + 1) / nr_workers;
+		pthread_create(&workers[t].thread, NULL, expand_range,
+			       &workers[t]);
+	}
+
+	out->len = 0;
+	for (int t = 0; t < nr_workers; ++t) {
+		pthread_join(workers[t].thread, NULL);
+		for (size_t i = 0; i < workers[t].out.len; ++i)
+			push(out, &workers[t].out.nodes[i]);
+	}
+
+	// Only the bits this layer set, for the next one.
+	for (size_t i = 0; i < out->len; ++i)
+		seen[memo_key(step, out->nodes[i].state) / 64] = 0;
+}
+
+/*
+ * Pins the kinds and decode values of the mystery() calls in a kernel log,
+ * pairing ioctl1 with ioctl2 and seek1 with seek2.
+ */
+static int load_log(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	char line[512];
+	int n = 0, half = 0;
+
+	if (!file) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), file)) {
+		const char *msg = strstr(line, "Mystery called by ");
+		unsigned int decode;
+		char func[8];
+
+		if (!msg || sscanf(msg, "Mystery called by %7s updated value to %u",
+				   func, &decode) != 2)
+			continue;
+
+		int second = !strcmp(func, "ioctl2") || !strcmp(func, "seek2");
+
+		if (second != half || n == MAX_STEPS) {
+			fprintf(stderr, "%s: unexpected %s\n", path, func);
+			fclose(file);
+			return -1;
+		}
+
+		struct step *step = &steps[second ? n - 1 : n++];
+
+		if (!second) {
+			*step = (struct step){ .decode = { -1, -1 }, .message = -1 };
+			if (!strcmp(func, "read"))
+				step->kind = CALL_READ;
+			else if (!strcmp(func, "write"))
+				step->kind = CALL_WRITE;
+			else if (!strcmp(func, "ioctl1"))
+				step->kind = CALL_IOCTL;
+			else
+				step->kind = CALL_LSEEK;
+		}
+		step->decode[second] = decode & 0xff;
+		half = !second && (step->kind == CALL_IOCTL ||
+				   step->kind == CALL_LSEEK);
+	}
+
+	fclose(file);
+	if (half) {
+		fprintf(stderr, "%s: the last call is cut short\n", path);
+		return -1;
+	}
+	return n;
+}
+
+static void print_byte(__u8 byte)
+{
+	if (isprint(byte) && byte != '\'' && byte != '\\')
+		printf("'%c'", byte);
+	else
+		printf("'\\x%02x'", byte);
+}
+
+static void print_call(const struct call *call)
+{
+	static const char *const whences[] = { "SEEK_SET", "SEEK_CUR",
+					       "SEEK_END" };
+
+	switch (call->kind) {
+	case CALL_READ:
+	case CALL_WRITE:
+		printf("%s(fd, buf, %d)", call_names[call->kind], call->a);
+		break;
+	case CALL_IOCTL:
+		// Clear of the commands the VFS handles itself.
+		printf("ioctl(fd, %#x, %#x)", 0x1000 | call->a, call->b);
+		break;
+	default:
+		printf("lseek(fd, %d, %s)", call->a, whences[call->whence]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *log = NULL, *message = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "l:m:")) != -1) {
+		if (opt == 'l')
+			log = optarg;
+		else if (opt == 'm')
+			message = optarg;
+		else
+			break;
+	}
+	if ((!log && !message) || optind < argc) {
+		fprintf(stderr, "usage: %s [-l log] [-m message]\n", argv[0]);
+		return 1;
+	}
+
+	ctf_op_init(&read_op, READ_MSECRET, READ_DSECRET);
+	ctf_op_init(&write_op, WRITE_MSECRET, WRITE_DSECRET);
+	ctf_op_init(&ioc_cmd_op, IOC_CMD_MSECRET, IOC_CMD_DSECRET);
+	ctf_op_init(&ioc_arg_op, IOC_ARG_MSECRET, IOC_ARG_DSECRET);
+	ctf_op_init(&seek_ops[SEEK_SET], SEEK_SET_MSECRET, SEEK_SET_DSECRET);
+	ctf_op_init(&seek_ops[SEEK_CUR], SEEK_CUR_MSECRET, SEEK_CUR_DSECRET);
+	ctf_op_init(&seek_ops[SEEK_END], SEEK_END_MSECRET, SEEK_END_DSECRET);
+
+	if (log) {
+		nr_steps = load_log(log);
+		if (nr_steps < 0)
+			return 1;
+	}
+	if (message) {
+		int len = strlen(message);
+
+		if (len > MAX_STEPS) {
+			fprintf(stderr, "messages are at most %d bytes\n",
+				MAX_STEPS);
+			return 1;
+		}
+		for (int k = nr_steps; k < len; ++k)
+			steps[k] = (struct step){ .kind = -1,
+						  .decode = { -1, -1 } };
+		for (int k = 0; k < len; ++k)
+			steps[k].message = bytes[k % sizeof(bytes)] ^
+					   (__u8)message[k];
+		if (len > nr_steps)
+			nr_steps = len;
+	}
+
+	for (int k = nr_steps - 1, free = 1; k >= 0; --k) {
+		free = free && steps[k].decode[0] < 0 && steps[k].decode[1] < 0;
+		steps[k].free_decode = free;
+	}
+
+	int nr_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	struct worker *workers = calloc(nr_workers, sizeof(*workers));
+	struct layer *layers = calloc(nr_steps + 1, sizeof(*layers));
+	struct node start = { .state = pack(INIT_MSECRET, INIT_DSECRET, 0) };
+	size_t explored = 1;
+	struct timespec t0, t1;
+
+	if (!workers || !layers) {
+		perror("calloc");
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	push(&layers[0], &start);
+	for (int k = 0; k < nr_steps; ++k) {
+		expand_layer(&layers[k], &layers[k + 1], &steps[k], workers,
+			     nr_workers);
+		explored += layers[k + 1].len;
+		if (!layers[k + 1].len) {
+			fprintf(stderr, "no syscall matches step %d\n", k + 1);
+			return 1;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	// Back from any state of the last layer.
+	static struct call script[MAX_STEPS];
+	static __u8 returned[MAX_STEPS];
+	__u32 index = 0;
+
+	for (int k = nr_steps; k > 0; --k) {
+		const struct node *node = &layers[k].nodes[index];
+		__u8 m, d;
+		unsigned int pos;
+
+		unpack(node->state, &m, &d, &pos);
+		script[k - 1] = node->call;
+		returned[k - 1] = bytes[(k - 1) % sizeof(bytes)] ^ m;
+		index = node->parent;
+	}
+
+	printf("fd = open(\"/dev/ctf\", O_RDWR);\n");
+	for (int k = 0; k < nr_steps; ++k) {
+		print_call(&script[k]);
+		printf(";\t// ");
+		print_byte(returned[k]);
+		printf("\n");
+	}
+	printf("// ");
+	for (int k = 0; k < nr_steps; ++k)
+		putchar(isprint(returned[k]) ? returned[k] : '.');
+	printf("\n");
+
+	fprintf(stderr, "%d syscalls, %zu states in %.3f ms on %d threads\n",
+		nr_steps, explored,
+		(t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6,
+		nr_workers);
+	return 0;
+}
@@ -0,0 +1,183 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "ctf.h"
+
+#define FILE_PATH "/dev/ctf"
+
+#define STEPS 4000
+#define THREADS 8
+
+#define TESTS_NUM 4
+
+void print_tests_num(int num) { printf("1..%d\n", num); }
+
+void print_result(bool success, int test_num, char *message)
+{
+	if (!success)
+		printf("not ");
+
+	printf("ok %d - %s\n", test_num, message);
+}
+
+/*
+ * Step @i of a fixed sequence covering every operation, returning what the
+ * device returned.  The seek keeps the file position in range.
+ */
+long step(int fd, int i)
+{
+	char buf[8] = { 0 };
+
+	switch (i % 4) {
+	case 0:
+		return ioctl(fd, 0x1000 | (i & 0xff), i);
+	case 1:
+		return write(fd, buf, 1 + i % 3);
+	case 2:
+		return read(fd, buf, 1 + i % 5);
+	default:
+		return lseek(fd, i % 200, SEEK_SET);
+	}
+}
+
+// The stream a file decodes when nothing else uses the device.
+long reference[STEPS];
+
+bool record_reference(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	for (int i = 0; i < STEPS; ++i)
+		reference[i] = step(fd, i);
+
+	close(fd);
+	return true;
+}
+
+bool test_file_exists(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	bool result = fd >= 0;
+
+	if (result)
+		close(fd);
+
+	return result;
+}
+
+bool test_second_open_keeps_stream(void)
+{
+	int first = open(FILE_PATH, O_RDWR);
+
+	if (first < 0)
+		return false;
+
+	bool result = true;
+
+	for (int i = 0; i < STEPS / 2; ++i)
+		result = result && step(first, i) == reference[i];
+
+	int second = open(FILE_PATH, O_RDWR);
+
+	result = result && second >= 0;
+
+	// Interleaved, each file carries on with its own stream.
+	for (int i = 0; result && i < STEPS / 2; ++i) {
+		result = step(second, i) == reference[i] &&
+			 step(first, STEPS / 2 + i) == reference[STEPS / 2 + i];
+	}
+
+	if (second >= 0)
+		close(second);
+	close(first);
+	return result;
+}
+
+struct opener {
+	pthread_barrier_t *start;
+	bool result;
+};
+
+void *open_and_decode(void *arg)
+{
+	struct opener *opener = arg;
+	int fd = open(FILE_PATH, O_RDWR);
+
+	pthread_barrier_wait(opener->start);
+	opener->result = fd >= 0;
+	for (int i = 0; opener->result && i < STEPS; ++i)
+		opener->result = step(fd, i) == reference[i];
+
+	if (fd >= 0)
+		close(fd);
+	return NULL;
+}
+
+bool test_parallel_openers(void)
+{
+	pthread_t threads[THREADS];
+	struct opener openers[THREADS];
+	pthread_barrier_t start;
+	bool result = true;
+
+	pthread_barrier_init(&start, NULL, THREADS);
+	for (int t = 0; t < THREADS; ++t) {
+		openers[t].start = &start;
+		pthread_create(&threads[t], NULL, open_and_decode, &openers[t]);
+	}
+	for (int t = 0; t < THREADS; ++t) {
+		pthread_join(threads[t], NULL);
+		result = result && openers[t].result;
+	}
+	pthread_barrier_destroy(&start);
+
+	return result;
+}
+
+bool test_stream_read(void)
+{
+	int single = open(FILE_PATH, O_RDWR);
+	int stream = open(FILE_PATH, O_RDWR);
+	unsigned char buf[13], byte;
+	bool result = single >= 0 && stream >= 0 &&
+		      ioctl(stream, CTF_STREAM, 1) == 0 &&
+		      read(stream, buf, sizeof(buf)) == sizeof(buf);
+
+	// Setting the mode does not run the cipher.
+	for (size_t i = 0; result && i < sizeof(buf); ++i)
+		result = read(single, &byte, 1) == buf[i];
+
+	if (stream >= 0)
+		close(stream);
+	if (single >= 0)
+		close(single);
+	return result;
+}
+
+int main(void)
+{
+	print_tests_num(TESTS_NUM);
+
+	int test_num = 1;
+
+	print_result(test_file_exists(), test_num++, "File exists");
+
+	bool recorded = record_reference();
+
+	print_result(recorded && test_second_open_keeps_stream(), test_num++,
+		     "A second open does not reset the first file's stream");
+	print_result(recorded && test_parallel_openers(), test_num++,
+		     "Parallel openers decode independent streams");
+	print_result(test_stream_read(), test_num++,
+		     "A streaming read returns the bytes of one-byte reads");
+
+	return 0;
+}
@@ -1,48 +1,129 @@
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "screen.h"
 #include "states.h"
 #include "game_of_life.h"
 
-static char main_buffer[GRID_STRING_SIZE];
-
-static int browse_states(void);
+/*
+ *  <----! Game of Life in the terminal ---->
+ *
+ *	  advanced [fps] [generations per second]
+ *		Static iteration ticks the board from its own thread at the
+ *		given rate (0 for as fast as the device goes, 10 by default),
+ *		while another thread renders at most fps frames per second
+ *		(30 by default).  Generations ticked between two frames are
+ *		never shown and counted as dropped.
+ */
+
+#define FRAME_SIZE (16384)
+
+// Glyphs, cells are two columns wide.
+#define LIVE_CELL "\xE2\x97\xBD"
+#define DEAD_CELL "\xE2\x97\xBE"
+#define BORDER_H "\xE2\x94\x81\xE2\x94\x81"
+#define BORDER_V "\xE2\x94\x83"
+#define CORNER_UL "\xE2\x94\x8F"
+#define CORNER_UR "\xE2\x94\x93"
+#define CORNER_LL "\xE2\x94\x97"
+#define CORNER_LR "\xE2\x94\x9B"
+
+struct frame {
+	char data[FRAME_SIZE];
+	size_t len;
+};
+
+/*
+ * The board is drawn below a status line, at the cursor position saved by
+ * its first frame.  Later frames only address the cells that changed.
+ */
+struct renderer {
+	char shown[ROWS][COLUMNS];	// on screen, '*' or ' '
+	int drawn;
+	struct frame frame;
+};
+
+struct simulation {
+	int fd;			// the board, ticked by one thread
+	const struct gol_shared *shared;	// mapped by the render thread
+	long generations;	// to tick, static iteration only
+	unsigned int gps;
+	unsigned int fps;
+	atomic_int done;
+	long dropped;
+};
+
+static int browse_states(struct renderer *r);
 static void clean_board(int state);
 static void write_state(int fd, const char *state);
-static void state_to_board(int state, char *buffer);
-static void render_board(const char *msg, int idx, int rest_cur);
+static void state_to_cells(int state, char cells[ROWS][COLUMNS]);
+static void render_board(struct renderer *r, char cells[ROWS][COLUMNS],
+			 const char *status, int rest_cur);
+static void *tick_thread(void *arg);
+static void *render_thread(void *arg);
 
-int main(void)
+int main(int argc, char **argv)
 {
+	struct simulation sim = {
+		.fps = argc > 1 ? atoi(argv[1]) : 30,
+		.gps = argc > 2 ? atoi(argv[2]) : 10,
+	};
+	static struct renderer browser;
+	pthread_t ticker, render;
+
+	if (!sim.fps)
+		sim.fps = 1;
+
 	// Enable raw-mode in terminal settings.
 	struct termios old_tio;
 
 	enable_raw_mode(&old_tio);
 	//										Title.
-	printf("				Welcome to the Game of Life!
-			\n\n");
+	printf("				Welcome to the Game of Life!\n\n");
 
 	// Let User choose the initial state.
-	int state = browse_states();
+	int state = browse_states(&browser);
+	char cells[ROWS][COLUMNS];
+	char status[64];
 
-	render_board("Chosen State:", state, 0);
+	state_to_cells(state, cells);
+	snprintf(status, sizeof(status), "Chosen State: [%02d]", state);
+	render_board(&browser, cells, status, 0);
 
 	// Disable raw-mode in terminal settings temporarily.
 	disable_raw_mode(&old_tio);
 
 	// Open character device.
-	int fd = open(DEVPATH, O_RDWR);
+	sim.fd = open(DEVPATH, O_RDWR);
 
-	if (fd < 0) {
+	if (sim.fd < 0) {
 		perror("\n\nFailed to open device.\n");
 		return -1;
 	}
 
 	// Write chosen state to character device.
-	write_state(fd, states[state]);
+	write_state(sim.fd, states[state]);
+
+	// The render thread copies each frame out of a read-only mapping: the
+	// header page and the two one-page buffers of a default size board.
+	int observer = ioctl(sim.fd, GOL_OBSERVE, getpid());
+
+	if (observer >= 0)
+		sim.shared = mmap(NULL, 3 * sysconf(_SC_PAGESIZE), PROT_READ,
+				  MAP_SHARED, observer, 0);
+	if (observer < 0 || sim.shared == MAP_FAILED) {
+		perror("\n\nFailed to observe device.\n");
+		return -1;
+	}
 
 	// Let user choose between Dynamic and Static iteration.
 	printf("\n- Dynamic iteration? [Y/n]" EMPTY_LINE);
@@ -57,25 +138,22 @@ int main(void)
 		printf("- Static iteration it is. How many generations?\n");
 
 		// Get number of iterations from user.
-		int generations = 1;
+		sim.generations = 1;
 
-		scanf(" %d", &generations);
+		scanf(" %ld", &sim.generations);
 
 		// Clean and setup board.
 		clean_board(state);
 
 		// Run the simulation.
-		for (int i = 1; i <= generations; ++i) {
-			ioctl(fd, GOL_TICK);
-			read(fd, main_buffer, 0);
-			render_board("Generation", i, 1);
-			usleep(500000);
-		}
+		pthread_create(&render, NULL, render_thread, &sim);
+		pthread_create(&ticker, NULL, tick_thread, &sim);
+		pthread_join(ticker, NULL);
 
 	} else {
 		// Dynamic iteration.
-		printf("- Dynamic iteration it is. Press Enter for next generation or 'q'
-				to quit.\n");
+		printf("- Dynamic iteration it is. Press Enter for next "
+		       "generation or 'q' to quit.\n");
 
 		// Clean and setup board.
 		clean_board(state);
@@ -83,18 +161,18 @@ int main(void)
 		// Enable raw-mode in terminal settings.
 		enable_raw_mode(&old_tio);
 
-		int generations = 1;
-
-		do {
-			read(fd, main_buffer, 0);
-			render_board("Generation", generations++, 1);
-			ioctl(fd, GOL_TICK);
-		}   while ((choice = getchar()) != 'q');
+		// This thread ticks, one generation per key.
+		pthread_create(&render, NULL, render_thread, &sim);
+		while ((choice = getchar()) != 'q' && choice != EOF)
+			ioctl(sim.fd, GOL_TICK);
 
 		// Disable raw-mode in terminal settings.
 		disable_raw_mode(&old_tio);
 	}
 
+	atomic_store(&sim.done, 1);
+	pthread_join(render, NULL);
+
 	// Move the curser down and exit.
 	move_cursor_down(HEIGHT + 7);
 	printf("\n");
@@ -119,16 +197,19 @@ static void clean_board(int state)
 	move_cursor_right(WIDTH - 13);
 }
 
-static int browse_states(void)
+static int browse_states(struct renderer *r)
 {
+	char cells[ROWS][COLUMNS];
+	char status[64];
 	char choice;
 	int state = 0;
 
 	printf("Choose the initial state: press Enter to choose\n");
 
 	while (1) {
-		state_to_board(state, main_buffer);
-		render_board("State", state, 1);
+		state_to_cells(state, cells);
+		snprintf(status, sizeof(status), "State [%02d]", state);
+		render_board(r, cells, status, 1);
 
 		choice = getchar();
 		if (choice == '\n')
@@ -154,87 +235,220 @@ static int browse_states(void)
 	return state;
 }
 
-static void state_to_board(int state, char *buffer)
+static void state_to_cells(int state, char cells[ROWS][COLUMNS])
 {
-	int idx = 0;
+	memset(cells, ' ', ROWS * COLUMNS);
+	for (int i = 0; states[state][i] && i < ROWS * COLUMNS; ++i) {
+		if (states[state][i] == '*')
+			cells[i / COLUMNS][i % COLUMNS] = '*';
+	}
+}
 
-	for (int j = 0; j < (WIDTH - 1); ++j)
-		buffer[idx++] = '-';
-	buffer[idx++] = '\n';
+static void write_state(int fd, const char *state)
+{
+	unsigned char bitmap[GOL_BITMAP_SIZE(ROWS, COLUMNS)] = { 0 };
 
-	for (int i = 0; i < ROWS; ++i) {
-		buffer[idx++] = '|';
-		for (int j = 0; j < COLUMNS; ++j)
-			buffer[idx++] = states[state][i * COLUMNS + j];
-		buffer[idx++] = '|';
-		buffer[idx++] = '\n';
+	// Pack the state and load it with a single write.
+	for (int i = 0; state[i] && i < ROWS * COLUMNS; ++i) {
+		if (state[i] == '*')
+			bitmap[i / 8] |= 1 << (i % 8);
 	}
 
-	for (int j = 0; j < (WIDTH - 1); ++j)
-		buffer[idx++] = '-';
-	buffer[idx++] = '\n';
-	buffer[idx++] = '\0';
+	ioctl(fd, GOL_LOAD, GOL_LOAD_BITMAP);
+	write(fd, bitmap, sizeof(bitmap));
+	ioctl(fd, GOL_LOAD, GOL_LOAD_TOGGLE);
 }
 
-static void write_state(int fd, const char *state)
+static void put(struct frame *f, const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	size_t room = sizeof(f->data) - f->len;
+	int n = vsnprintf(f->data + f->len, room, fmt, args);
+
+	va_end(args);
+	// A full frame is cut short rather than overflowing.
+	if (n > 0)
+		f->len += (size_t)n < room ? (size_t)n : room - 1;
+}
+
+static void put_border(struct frame *f, const char *left, const char *right)
+{
+	put(f, "%s", left);
+	for (int j = 0; j < COLUMNS; ++j)
+		put(f, BORDER_H);
+	put(f, "%s", right);
+}
+
+/*
+ * Composes the frame and writes it with a single write(2).  The first frame
+ * draws the whole board, the next ones restore the saved cursor and move to
+ * each changed cell; cells in a row right after one just drawn need no move.
+ * With @rest_cur the cursor goes back to the status line, otherwise it is
+ * left after the bottom right corner.
+ */
+static void render_board(struct renderer *r, char cells[ROWS][COLUMNS],
+			 const char *status, int rest_cur)
 {
-	for (int i = 0; state[i]; ++i) {
-		if (state[i] == '*') {
-			lseek(fd, i, SEEK_SET);
-			write(fd, NULL, 0);
+	struct frame *f = &r->frame;
+
+	f->len = 0;
+	put(f, "\033[?25l");
+
+	if (!r->drawn) {
+		put(f, "\0337%s\033[K\n", status);
+		put_border(f, CORNER_UL, CORNER_UR);
+		for (int i = 0; i < ROWS; ++i) {
+			put(f, "\n" BORDER_V);
+			for (int j = 0; j < COLUMNS; ++j)
+				put(f, "%s", cells[i][j] == '*' ? LIVE_CELL :
+								    DEAD_CELL);
+			put(f, BORDER_V);
+		}
+		put(f, "\n");
+		put_border(f, CORNER_LL, CORNER_LR);
+		memcpy(r->shown, cells, sizeof(r->shown));
+		r->drawn = 1;
+	} else {
+		put(f, "\0338%s\033[K", status);
+		for (int i = 0; i < ROWS; ++i) {
+			int next = -1;
+
+			for (int j = 0; j < COLUMNS; ++j) {
+				if (cells[i][j] == r->shown[i][j])
+					continue;
+				// Below the status line and the top border.
+				if (j != next)
+					put(f, "\0338\033[%dB\r\033[%dC", i + 2,
+					    2 * j + 1);
+				put(f, "%s", cells[i][j] == '*' ? LIVE_CELL :
+								    DEAD_CELL);
+				r->shown[i][j] = cells[i][j];
+				next = j + 1;
+			}
 		}
+		if (!rest_cur)
+			put(f, "\0338\033[%dB\r\033[%dC", HEIGHT,
+			    2 * COLUMNS + 2);
+	}
+
+	if (rest_cur)
+		put(f, "\0338");
+	put(f, "\033[?25h");
+
+	// Anything printed so far goes first.
+	fflush(stdout);
+	for (size_t done = 0; done < f->len;) {
+		ssize_t n = write(STDOUT_FILENO, f->data + done, f->len - done);
+
+		if (n <= 0)
+			break;
+		done += n;
 	}
 }
 
-static void render_board(const char *msg, int idx, int rest_cur)
+static long long now_ns(void)
 {
-	hide_cursor();
-	save_cursor();
-	printf("%s [%02u]" EMPTY_LINE, msg, idx);
+	struct timespec ts;
 
-	for (int idx = 0; main_buffer[idx]; ++idx) {
-		if (idx % WIDTH == 0)
-			printf("\n");
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-		if (idx == 0) {
-			// Left Up Corner
-			printf("\xE2\x94\x8F");
+static void sleep_until(long long ns)
+{
+	struct timespec ts = { .tv_sec = ns / 1000000000LL,
+			       .tv_nsec = ns % 1000000000LL };
 
-		} else if (idx == 33) {
-			// Right Up Corner
-			printf("\xE2\x94\x93");
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
 
-		} else if (idx == 595) {
-			// Left Bottom Corner
-			printf("\xE2\x94\x97");
+static void *tick_thread(void *arg)
+{
+	struct simulation *sim = arg;
+	long long next = now_ns();
 
-		} else if (idx == 628) {
-			// Right Bottom Corner
-			printf("\xE2\x94\x9B");
+	for (long i = 0; i < sim->generations; ++i) {
+		ioctl(sim->fd, GOL_TICK);
 
-		} else if (main_buffer[idx] == '|') {
-			// Vertical Border
-			printf("\xE2\x94\x83");
+		if (sim->gps) {
+			next += 1000000000LL / sim->gps;
+			sleep_until(next);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Copies the front buffer to @cells and returns the generation it holds,
+ * read between two loads of the same even seq so the two always match.
+ */
+static long read_frame(const struct gol_shared *shared,
+		       char cells[ROWS][COLUMNS])
+{
+	__u32 board[ROWS * ((COLUMNS + 31) / 32)];
+	const int words = (COLUMNS + 31) / 32;
+	long generation;
+	__u32 seq;
+
+	do {
+		seq = __atomic_load_n(&shared->seq, __ATOMIC_ACQUIRE);
+		memcpy(board, (const char *)shared +
+			      shared->offset[shared->front], sizeof(board));
+		generation = shared->generation;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (seq % 2 ||
+		 __atomic_load_n(&shared->seq, __ATOMIC_RELAXED) != seq);
+
+	for (int i = 0; i < ROWS; ++i)
+		for (int j = 0; j < COLUMNS; ++j)
+			cells[i][j] = board[i * words + j / 32] >> (j % 32) & 1 ?
+				      '*' : ' ';
+	return generation;
+}
 
-		} else if (main_buffer[idx] == '-') {
-			// Horizontal Border
-			printf("\xE2\x94\x81\xE2\x94\x81");
+static void *render_thread(void *arg)
+{
+	struct simulation *sim = arg;
+	static struct renderer r;
+	char cells[ROWS][COLUMNS];
+	char status[96];
+	long long period = 1000000000LL / sim->fps;
+	long long next = now_ns(), window = next;
+	long shown = 0, frames = 0;
+	unsigned int fps = 0;
+
+	for (int first = 1;; first = 0) {
+		// Checked first, so the last generation still gets its frame.
+		int done = atomic_load(&sim->done);
+		long generation = read_frame(sim->shared, cells);
+
+		if (first || generation != shown) {
+			if (generation > shown + 1)
+				sim->dropped += generation - shown - 1;
+			shown = generation;
+			++frames;
+			snprintf(status, sizeof(status),
+				 "Generation [%02ld]  %u fps  %ld dropped",
+				 shown, fps, sim->dropped);
+			render_board(&r, cells, status, 1);
+		}
+		if (done)
+			break;
 
-		} else if (main_buffer[idx] == '*') {
-			// Live Cell
-			printf("\xE2\x97\xBD");
+		// A frame that took longer than its period delays the rest.
+		long long now = now_ns();
 
-		} else if (main_buffer[idx] == ' ') {
-			// Dead Cell
-			printf("\xE2\x97\xBE");
+		next = next + period > now ? next + period : now;
+		sleep_until(next);
 
-		} else {
-			continue;
+		now = now_ns();
+		if (now - window >= 1000000000LL) {
+			fps = frames * 1e9 / (now - window) + 0.5;
+			frames = 0;
+			window = now;
 		}
 	}
-
-	render_screen();
-	if (rest_cur)
-		restore_cursor();
-	show_cursor();
+	return NULL;
 }
@@ -0,0 +1,263 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game_of_life.h"
+
+/*
+ *  <----! Game of Life benchmarks ---->
+ *
+ *	  bench tick [max_procs] [ticks] [rows] [cols]
+ *		Runs 1, 2, 4, ... max_procs processes, each ticking its own
+ *		board, and reports the total tick throughput.
+ *
+ *	  bench open [max_threads] [opens] [holders]
+ *		Runs 1, 2, 4, ... max_threads threads, each opening and closing
+ *		its own board, while @holders other threads keep a board open,
+ *		and reports the open/close throughput and mean latency.
+ */
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int open_board(unsigned int rows, unsigned int cols)
+{
+	int fd = open(DEVPATH, O_RDWR);
+
+	if (fd < 0) {
+		perror("open");
+		return -1;
+	}
+
+	struct gol_geometry geometry = { .rows = rows, .columns = cols };
+
+	if (ioctl(fd, GOL_GEOMETRY, &geometry) < 0) {
+		perror("GOL_GEOMETRY");
+		close(fd);
+		return -1;
+	}
+
+	// Random soup, about a third of the cells alive.
+	for (unsigned int i = 0; i < rows * cols; ++i) {
+		if (rand() % 3 == 0) {
+			lseek(fd, i, SEEK_SET);
+			write(fd, NULL, 0);
+		}
+	}
+	return fd;
+}
+
+/*
+ * Every child reports readiness on @ready and waits for @go to be closed,
+ * so setting up the boards is not part of the measurement.
+ */
+static double run_tick_procs(int procs, long ticks, unsigned int rows,
+			     unsigned int cols)
+{
+	int ready[2], go[2];
+	char byte = 0;
+
+	if (pipe(ready) < 0 || pipe(go) < 0) {
+		perror("pipe");
+		return -1;
+	}
+
+	for (int p = 0; p < procs; ++p) {
+		pid_t pid = fork();
+
+		if (pid < 0) {
+			perror("fork");
+			return -1;
+		}
+		if (pid)
+			continue;
+
+		close(go[1]);
+		srand(p + 1);
+		int fd = open_board(rows, cols);
+
+		write(ready[1], &byte, 1);
+		read(go[0], &byte, 1);
+		if (fd < 0)
+			_exit(1);
+
+		// One syscall per generation, so period detection can't skip work.
+		for (long i = 0; i < ticks; ++i)
+			ioctl(fd, GOL_TICK);
+
+		close(fd);
+		_exit(0);
+	}
+
+	for (int p = 0; p < procs; ++p)
+		read(ready[0], &byte, 1);
+
+	double start = now();
+	int failed = 0;
+
+	close(go[1]);
+	for (int p = 0; p < procs; ++p) {
+		int status;
+
+		wait(&status);
+		failed |= !WIFEXITED(status) || WEXITSTATUS(status);
+	}
+
+	double elapsed = now() - start;
+
+	close(go[0]);
+	close(ready[0]);
+	close(ready[1]);
+
+	return failed ? -1 : procs * ticks / elapsed;
+}
+
+static int bench_tick(int argc, char **argv)
+{
+	int max_procs = argc > 0 ? atoi(argv[0]) : 8;
+	long ticks = argc > 1 ? atol(argv[1]) : 100000;
+	unsigned int rows = argc > 2 ? atoi(argv[2]) : ROWS;
+	unsigned int cols = argc > 3 ? atoi(argv[3]) : COLUMNS;
+	double base = 0;
+
+	printf("%ux%u board, %ld ticks per process\n", rows, cols, ticks);
+	printf("procs	ticks/s		speedup\n");
+
+	for (int procs = 1; procs <= max_procs; procs *= 2) {
+		double rate = run_tick_procs(procs, ticks, rows, cols);
+
+		if (rate < 0)
+			return 1;
+		if (procs == 1)
+			base = rate;
+		printf("%d	%.0f	%.2fx\n", procs, rate, rate / base);
+	}
+	return 0;
+}
+
+struct open_args {
+	pthread_barrier_t *start;
+	pthread_barrier_t *release;
+	long opens;
+	int hold;
+	int failed;
+};
+
+/*
+ * Boards belong to the opening thread, so every thread opens its own.
+ * Holders open once and keep the board until @release is crossed, which
+ * keeps the registry populated while the openers run.
+ */
+static void *open_thread(void *arg)
+{
+	struct open_args *args = arg;
+
+	if (args->hold) {
+		int fd = open(DEVPATH, O_RDWR);
+
+		args->failed = fd < 0;
+		pthread_barrier_wait(args->start);
+		pthread_barrier_wait(args->release);
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+
+	pthread_barrier_wait(args->start);
+	for (long i = 0; i < args->opens; ++i) {
+		int fd = open(DEVPATH, O_RDWR);
+
+		if (fd < 0) {
+			args->failed = 1;
+			break;
+		}
+		close(fd);
+	}
+	return NULL;
+}
+
+static double run_open_threads(int threads, long opens, int holders)
+{
+	int total = threads + holders;
+	pthread_t tids[total];
+	struct open_args args[total];
+	pthread_barrier_t start, release;
+	int failed = 0;
+
+	// The main thread joins the barriers too, so it can time the openers.
+	pthread_barrier_init(&start, NULL, total + 1);
+	pthread_barrier_init(&release, NULL, holders + 1);
+	for (int t = 0; t < total; ++t) {
+		args[t] = (struct open_args){ .start = &start,
+					      .release = &release,
+					      .opens = opens,
+					      .hold = t >= threads };
+		pthread_create(&tids[t], NULL, open_thread, &args[t]);
+	}
+
+	pthread_barrier_wait(&start);
+	double begin = now();
+
+	for (int t = 0; t < threads; ++t)
+		pthread_join(tids[t], NULL);
+
+	double elapsed = now() - begin;
+
+	// Release the holders.
+	pthread_barrier_wait(&release);
+	for (int t = 0; t < total; ++t) {
+		if (t >= threads)
+			pthread_join(tids[t], NULL);
+		failed |= args[t].failed;
+	}
+	pthread_barrier_destroy(&release);
+	pthread_barrier_destroy(&start);
+
+	return failed ? -1 : threads * opens / elapsed;
+}
+
+static int bench_open(int argc, char **argv)
+{
+	int max_threads = argc > 0 ? atoi(argv[0]) : 8;
+	long opens = argc > 1 ? atol(argv[1]) : 10000;
+	int holders = argc > 2 ? atoi(argv[2]) : 0;
+
+	printf("%ld opens per thread, %d holders\n", opens, holders);
+	printf("threads	opens/s		latency\n");
+
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		double rate = run_open_threads(threads, opens, holders);
+
+		if (rate < 0) {
+			fprintf(stderr, "open failed\n");
+			return 1;
+		}
+		printf("%d	%.0f	%.2fus\n", threads, rate,
+		       threads * 1e6 / rate);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && strcmp(argv[1], "tick") == 0)
+		return bench_tick(argc - 2, argv + 2);
+	if (argc > 1 && strcmp(argv[1], "open") == 0)
+		return bench_open(argc - 2, argv + 2);
+
+	fprintf(stderr, "usage: %s tick [max_procs] [ticks] [rows] [cols]\n"
+			"       %s open [max_threads] [opens] [holders]\n",
+		argv[0], argv[0]);
+	return 1;
+}
@@ -0,0 +1,427 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game_of_life.h"
+#include "life.h"
+#include "states.h"
+
+/*
+ *  <----! Game of Life differential fuzzer ---->
+ *
+ *	  fuzz [-e engine] [-s size] [-b] [-S] [iterations] [seed]
+ *		Loads random boards into the device and into liblife.a, runs
+ *		them for random numbers of generations under random rules and
+ *		compares the device, the SWAR engine and the reference engine
+ *		after every step.  Prints the command to rerun the first
+ *		mismatch with, or the ticks per second of each side.  The
+ *		device skips whole periods once it detects one, which its rate
+ *		includes.
+ *
+ *		-e sets the module's engine parameter (scalar, swar or
+ *		hashlife) for the run, which needs root, and puts it back on
+ *		exit.  Hashlife only takes B3/S23 on boards whose sides are
+ *		powers of two, so with it the sides are rounded down to one,
+ *		half of the boards follow B3/S23 and steps run up to 1024
+ *		generations.  -s is the largest side of a board, 256 by
+ *		default.  -b sets parallel_min_cells to 0, so that boards of 32
+ *		rows or more are split into bands, one per online CPU, and
+ *		checks the bands against the serial engines.  -S runs B3/S23
+ *		on the boards of states.h instead of random ones.
+ */
+
+static const char *const rules[] = {
+	"B3/S23",	/* Conway */
+	"B36/S23",	/* HighLife */
+	"B2/S",		/* Seeds */
+	"B3678/S34678",	/* Day & Night */
+	"B1357/S1357",	/* Replicator */
+	"B368/S245",	/* Morley */
+	"B0123478/S01234678", /* B0, the whole board flips */
+	"B012345678/S012345678",
+};
+
+#define NR_RULES (sizeof(rules) / sizeof(rules[0]))
+
+/* Values of the engine module parameter */
+static const char *const engines[] = { "scalar", "swar", "hashlife" };
+
+#define ENGINE_HASHLIFE (2)
+#define NR_ENGINES (sizeof(engines) / sizeof(engines[0]))
+
+#define PARAM_DIR "/sys/module/game_of_life/parameters/"
+
+/* A module parameter the run changes, put back by restore_params() */
+struct param {
+	const char *name;
+	char old[32];
+	int saved;
+};
+
+static struct param engine_param = { .name = "engine" };
+static struct param bands_param = { .name = "parallel_min_cells" };
+
+static int engine = -1;		/* -e, -1 leaves the parameter alone */
+static unsigned int max_side = 256;	/* -s */
+static int from_states;			/* -S */
+
+struct side {
+	const char *name;
+	double seconds;
+	unsigned long long generations;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int write_param(const char *name, const char *value)
+{
+	char path[128];
+	FILE *file;
+
+	snprintf(path, sizeof(path), PARAM_DIR "%s", name);
+	file = fopen(path, "w");
+	if (!file || fprintf(file, "%s\n", value) < 0 || fclose(file)) {
+		perror(path);
+		return -1;
+	}
+	return 0;
+}
+
+/* Sets @param to @value, keeping the value it had the first time. */
+static int set_param(struct param *param, const char *value)
+{
+	if (!param->saved) {
+		char path[128];
+		FILE *file;
+
+		snprintf(path, sizeof(path), PARAM_DIR "%s", param->name);
+		file = fopen(path, "r");
+		if (!file || !fgets(param->old, sizeof(param->old), file)) {
+			perror(path);
+			if (file)
+				fclose(file);
+			return -1;
+		}
+		fclose(file);
+		param->old[strcspn(param->old, "\n")] = '\0';
+		param->saved = 1;
+	}
+	return write_param(param->name, value);
+}
+
+static void restore_params(void)
+{
+	if (engine_param.saved)
+		write_param(engine_param.name, engine_param.old);
+	if (bands_param.saved)
+		write_param(bands_param.name, bands_param.old);
+}
+
+/* @n with all but its highest set bit cleared */
+static unsigned int round_down_pow2(unsigned int n)
+{
+	return 1U << (31 - __builtin_clz(n));
+}
+
+static int open_board(const struct life *life, const char *rule,
+		      const unsigned char *bitmap, size_t size)
+{
+	struct gol_geometry geometry = { .rows = life->rows,
+					 .columns = life->cols };
+	struct gol_rule gol_rule;
+	int fd = open(DEVPATH, O_RDWR);
+
+	if (fd < 0) {
+		perror("open");
+		return -1;
+	}
+
+	snprintf(gol_rule.rule, sizeof(gol_rule.rule), "%s", rule);
+	if (ioctl(fd, GOL_GEOMETRY, &geometry) < 0 ||
+	    ioctl(fd, GOL_RULE, &gol_rule) < 0 ||
+	    ioctl(fd, GOL_FORMAT, GOL_FORMAT_BITMAP) < 0 ||
+	    ioctl(fd, GOL_LOAD, GOL_LOAD_BITMAP) < 0 ||
+	    write(fd, bitmap, size) != (ssize_t)size) {
+		perror("load");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Either one GOL_TICK per generation or GOL_TICK_N, picked by @single. */
+static int tick_device(int fd, __u64 generations, int single)
+{
+	if (single) {
+		for (__u64 i = 0; i < generations; ++i)
+			if (ioctl(fd, GOL_TICK) < 0)
+				return -1;
+		return 0;
+	}
+
+	__u64 done = generations;
+
+	if (ioctl(fd, GOL_TICK_N, &done) < 0)
+		return -1;
+	if (done != generations) {
+		errno = EIO;
+		return -1;
+	}
+	return 0;
+}
+
+static void report(const struct life *life, const char *side,
+		   const unsigned char *expected, const unsigned char *got)
+{
+	unsigned int stride = (life->cols + 7) / 8;
+
+	for (unsigned int r = 0; r < life->rows; ++r) {
+		for (unsigned int c = 0; c < life->cols; ++c) {
+			size_t byte = (size_t)r * stride + c / 8;
+			int want = expected[byte] >> (c % 8) & 1;
+
+			if (want != (got[byte] >> (c % 8) & 1)) {
+				fprintf(stderr,
+					"%s: cell (%u, %u) is %s, expected %s\n",
+					side, r, c, want ? "dead" : "alive",
+					want ? "alive" : "dead");
+				return;
+			}
+		}
+	}
+}
+
+/*
+ * One board, from @seed alone so that a mismatch can be rerun.  Returns 0,
+ * 1 on a mismatch or -1 if the device failed.
+ */
+static int fuzz_one(unsigned int seed, struct side sides[3])
+{
+	struct life reference, swar;
+	unsigned int rows, cols;
+	int ret = -1;
+
+	srand(seed);
+	// Mostly small boards, where the edges wrap around a lot, some large.
+	if (rand() % 16) {
+		rows = 1 + rand() % (max_side < 48 ? max_side : 48);
+		cols = 1 + rand() % (max_side < 160 ? max_side : 160);
+	} else {
+		rows = 1 + rand() % max_side;
+		cols = 1 + rand() % max_side;
+	}
+
+	const char *rule = rules[rand() % NR_RULES];
+	unsigned int max_generations = 64;
+
+	if (engine == ENGINE_HASHLIFE) {
+		rows = round_down_pow2(rows);
+		cols = round_down_pow2(cols);
+		if (rand() % 2)
+			rule = rules[0];
+		max_generations = 1024;
+	}
+
+	int state = -1;
+
+	if (from_states) {
+		state = rand() % num_states;
+		rows = ROWS;
+		cols = COLUMNS;
+		rule = rules[0];
+	}
+
+	int density = rand() % 101;
+	size_t size = GOL_BITMAP_SIZE((size_t)rows, cols);
+	unsigned char *bitmap = malloc(size);
+	unsigned char *expected = malloc(size);
+
+	if (!bitmap || !expected || life_init(&reference, rows, cols) < 0) {
+		perror("fuzz");
+		free(bitmap);
+		free(expected);
+		return -1;
+	}
+	if (life_init(&swar, rows, cols) < 0) {
+		perror("fuzz");
+		goto out_reference;
+	}
+
+	for (unsigned int r = 0; r < rows; ++r) {
+		for (unsigned int c = 0; c < cols; ++c) {
+			size_t i = (size_t)r * cols + c;
+			int alive = state < 0 ? rand() % 100 < density :
+				    i < strlen(states[state]) &&
+				    states[state][i] == '*';
+
+			life_set_cell(&reference, r, c, alive);
+		}
+	}
+	life_set_rule(&reference, rule);
+	life_set_rule(&swar, rule);
+	life_store_bitmap(&reference, bitmap);
+	life_load_bitmap(&swar, bitmap);
+
+	int fd = open_board(&reference, rule, bitmap, size);
+
+	if (fd < 0)
+		goto out_swar;
+
+	for (int steps = 1 + rand() % 4; steps; --steps) {
+		__u64 generations = 1 + rand() % max_generations;
+		int single = rand() % 2;
+		double start = now();
+
+		if (tick_device(fd, generations, single) < 0) {
+			perror("tick");
+			goto out_fd;
+		}
+		sides[0].seconds += now() - start;
+
+		start = now();
+		for (__u64 i = 0; i < generations; ++i)
+			life_tick(&swar);
+		sides[1].seconds += now() - start;
+
+		start = now();
+		for (__u64 i = 0; i < generations; ++i)
+			life_tick_reference(&reference);
+		sides[2].seconds += now() - start;
+
+		for (int s = 0; s < 3; ++s)
+			sides[s].generations += generations;
+
+		if (read(fd, bitmap, size) != (ssize_t)size) {
+			perror("read");
+			goto out_fd;
+		}
+		life_store_bitmap(&reference, expected);
+		if (memcmp(bitmap, expected, size)) {
+			report(&reference, sides[0].name, expected, bitmap);
+			ret = 1;
+			break;
+		}
+		life_store_bitmap(&swar, bitmap);
+		if (memcmp(bitmap, expected, size)) {
+			report(&reference, sides[1].name, expected, bitmap);
+			ret = 1;
+			break;
+		}
+	}
+
+	if (ret == 1 && state >= 0)
+		fprintf(stderr, "seed %u: state %d, generation %llu\n", seed,
+			state, (unsigned long long)reference.generation);
+	else if (ret == 1)
+		fprintf(stderr, "seed %u: %ux%u %s, %d%% alive, generation %llu\n",
+			seed, rows, cols, rule, density,
+			(unsigned long long)reference.generation);
+	else
+		ret = 0;
+out_fd:
+	close(fd);
+out_swar:
+	life_free(&swar);
+out_reference:
+	life_free(&reference);
+	free(bitmap);
+	free(expected);
+	return ret;
+}
+
+static int usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-e scalar|swar|hashlife] [-s size] [-b] "
+		"[-S] [iterations] [seed]\n", name);
+	return 2;
+}
+
+int main(int argc, char **argv)
+{
+	struct side sides[3] = {
+		{ .name = "device" },
+		{ .name = "swar" },
+		{ .name = "reference" },
+	};
+	char options[64] = "";
+	int bands = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "e:s:bS")) != -1) {
+		switch (opt) {
+		case 'e':
+			for (engine = NR_ENGINES - 1; engine >= 0; --engine)
+				if (!strcmp(optarg, engines[engine]))
+					break;
+			if (engine < 0)
+				return usage(argv[0]);
+			break;
+		case 's':
+			max_side = strtoul(optarg, NULL, 0);
+			if (max_side < 1 || max_side > GOL_MAX_ROWS ||
+			    max_side > GOL_MAX_COLUMNS)
+				return usage(argv[0]);
+			break;
+		case 'b':
+			bands = 1;
+			break;
+		case 'S':
+			from_states = 1;
+			break;
+		default:
+			return usage(argv[0]);
+		}
+	}
+
+	long iterations = optind < argc ? atol(argv[optind]) : 1000;
+	unsigned int seed = optind + 1 < argc ?
+			    strtoul(argv[optind + 1], NULL, 0) :
+			    (unsigned int)time(NULL);
+
+	atexit(restore_params);
+	if (engine >= 0) {
+		char value[4];
+
+		snprintf(value, sizeof(value), "%d", engine);
+		if (set_param(&engine_param, value) < 0)
+			return 1;
+		snprintf(options, sizeof(options), " -e %s", engines[engine]);
+	}
+	if (bands && set_param(&bands_param, "0") < 0)
+		return 1;
+	snprintf(options + strlen(options), sizeof(options) - strlen(options),
+		 " -s %u%s%s", max_side, bands ? " -b" : "",
+		 from_states ? " -S" : "");
+
+	printf("%ld boards from seed %u\n", iterations, seed);
+
+	for (long i = 0; i < iterations; ++i) {
+		int ret = fuzz_one(seed + i, sides);
+
+		if (ret) {
+			if (ret > 0)
+				fprintf(stderr, "rerun with: %s%s 1 %u\n",
+					argv[0], options,
+					seed + (unsigned int)i);
+			return 1;
+		}
+	}
+
+	printf("side		generations	ticks/s\n");
+	for (int s = 0; s < 3; ++s)
+		printf("%-9s	%llu		%.0f\n", sides[s].name,
+		       sides[s].generations,
+		       sides[s].generations / sides[s].seconds);
+	return 0;
+}
@@ -1,269 +1,2691 @@
 
+#include <linux/anon_inodes.h>
 #include <linux/cdev.h>
+#include <linux/ctype.h>
+#include <linux/debugfs.h>
 #include <linux/errname.h>
 #include <linux/errno.h>
 #include <linux/fs.h>
 #include <linux/kdev_t.h>
+#include <linux/kref.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
+#include <linux/sched/signal.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/list.h>
+#include <linux/xarray.h>
+#include <linux/bitops.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+#include <linux/vmalloc.h>
+#include <linux/hash.h>
+#include <linux/hrtimer.h>
+#include <linux/minmax.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/wait.h>
+#include <linux/xxhash.h>
 
 #include "game_of_life.h"
+#include "gol_swar.h"
+
+#define CREATE_TRACE_POINTS
+#include "game_of_life_trace.h"
 
 /* Define kernel macros */
 #if defined(pr_fmt)
 #undef pr_fmt
 #endif
 
-#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+/* Tick engines, selected through the "engine" module parameter */
+enum gol_engine {
+	GOL_ENGINE_SCALAR,	/* cell by cell reference implementation */
+	GOL_ENGINE_SWAR,	/* bit-sliced, one row per machine word */
+	GOL_ENGINE_HASHLIFE,	/* memoized quadtree, power of two boards */
+};
+
+static int engine = GOL_ENGINE_SWAR;
+module_param(engine, int, 0644);
+MODULE_PARM_DESC(engine, "Tick engine: 0 = scalar reference, 1 = bit-sliced SWAR (default), 2 = Hashlife for long GOL_TICK_N runs");
+
+/*
+ * Boards of at least parallel_min_cells cells are split into row bands that
+ * are ticked concurrently, one band per online CPU up to GOL_MAX_BANDS, and
+ * never less than GOL_MIN_BAND_ROWS rows per band.
+ */
+#define GOL_MAX_BANDS (32)
+#define GOL_MIN_BAND_ROWS (16)
+
+static unsigned int parallel_min_cells = 1 << 18;
+module_param(parallel_min_cells, uint, 0644);
+MODULE_PARM_DESC(parallel_min_cells, "Smallest board (in cells) ticked on several CPUs");
+
+static struct workqueue_struct *gol_wq;
+
+/* Bands only, run_work waits for them from gol_wq while holding the lock */
+static struct workqueue_struct *gol_band_wq;
+
+/* One directory per board, named by the thread that opened it */
+static struct dentry *gol_debugfs;
+
+/* Number of recent generations remembered for period detection */
+#define GOL_CYCLE_RING (64)
+
+/*
+ * Hashes of the most recent generations, slot g % GOL_CYCLE_RING holds the
+ * hash of generation g.  The board hash is the xor of a hash per tile, so a
+ * tick only rehashes the tiles it changed.  Once generation g hashes like
+ * generation g - p the two boards are compared, from the history or the copy
+ * in board, and when neither holds g - p the copy takes generation g and
+ * period p is confirmed against generation g + p instead.  A confirmed cycle
+ * stops the ring until the board is modified from userspace.
+ */
+struct gol_cycle {
+	u64 hash[GOL_CYCLE_RING];
+	unsigned int depth;	/* number of valid slots, 0 after a reset */
+	u64 period;		/* 0 while no cycle was found */
+	u64 start;		/* first generation of the cycle */
+	u64 board_hash;		/* of the current generation */
+	u64 *tile_hash;		/* per tile, xored into board_hash */
+	u32 *board;		/* copy of generation checked */
+	u64 checked;		/* U64_MAX while board holds nothing */
+	u64 candidate;		/* period awaiting confirmation, or 0 */
+};
+
+static unsigned int history_max_mb = 16;
+module_param(history_max_mb, uint, 0644);
+MODULE_PARM_DESC(history_max_mb, "Memory cap of each board's generation history in MiB");
+
+/*
+ * Generations before the current one, as they were when they were ticked.
+ * Generation g sits in slot g % depth while gen[g % depth] is g; the
+ * generations skipped over by period detection or the Hashlife engine and
+ * the ones rewound past never get a slot.
+ */
+struct gol_history {
+	u32 *boards;		/* depth boards of rows * words words */
+	u64 *gen;		/* generation held by each slot */
+	unsigned int depth;	/* 0 while disabled */
+};
+
+/* Tick durations from 0 ns to 2^30 ns and more, by their log2 */
+#define GOL_LATENCY_BUCKETS (32)
+
+/* Shown in debugfs, under the board's lock */
+struct gol_counters {
+	u64 generations;	/* ticked by any engine */
+	u64 reads;
+	u64 read_bytes;
+	u64 writes;
+	u64 tick_ns[GOL_LATENCY_BUCKETS];	/* bucket b from 2^(b - 1) ns */
+};
+
+/*
+ * A Life-like rule in B/S notation: bit n of birth (survive) is set when a
+ * dead (live) cell with n live neighbors is alive in the next generation.
+ * next[] holds the next state of the centre of every 3x3 neighborhood, the
+ * cells in bits 8..0 column by column from the west, each column from the
+ * north, so bit 4 is the centre.
+ */
+struct rule_table {
+	u16 birth;
+	u16 survive;
+	u8 next[512];
+};
+
+/*
+ * The board is bit-packed, each row takes "words" u32 words and bit j of word
+ * k holds column 32 * k + j.  Bits past the last column are always clear.
+ */
+struct gol_info;
+
+/*
+ * Tiles are GOL_TILE_ROWS rows of a single word, tile (r, k) covering word k
+ * of rows GOL_TILE_ROWS * r onwards.  A tile that did not change in the last
+ * generation and whose eight neighbors did not either cannot change in the
+ * next one, so the dense engines skip it.  Its back buffer words still hold
+ * the generation before, which is the same as the current one.
+ */
+#define GOL_TILE_ROWS (8)
+
+/* Rows [first, last) of the next generation */
+struct gol_band {
+	struct work_struct work;
+	struct gol_info *data;
+	unsigned int first;
+	unsigned int last;
+	bool scalar;
+};
+
+/*
+ * A board is shared by the file that created it and the observers opened on
+ * it with GOL_OBSERVE, each holding a reference.  Everything below the lock
+ * is protected by it.  Every change to the board is a new frame.
+ */
+struct gol_info {
+	struct kref ref;
+	struct rcu_head rcu;
+	pid_t owner;		/* thread that opened the board */
+	bool detached;		/* the owner's file was closed */
+	wait_queue_head_t wait;	/* woken on new frames and on detach */
+	struct mutex lock;
+	char live_cell;
+	char dead_cell;
+	struct rule_table rule;
+	unsigned int rows;
+	unsigned int cols;
+	unsigned int words;
+	struct gol_shared *shared;	/* header page, then both buffers */
+	struct mutex map_lock;	/* orders mmap(2) against GOL_GEOMETRY */
+	atomic_t mapped;	/* live mmap(2)s of the buffers */
+	u32 *board;		/* rows * words words in shared */
+	u32 *back;		/* next generation, swapped with board */
+	u64 *row_frame;		/* frame in which each row last changed */
+	u64 diff_frame;		/* last frame in which any row changed */
+	unsigned int tile_rows;
+	u8 *tiles;		/* the three maps below */
+	u8 *tile_changed;	/* tiles that changed in the last generation */
+	u8 *tile_next;		/* tiles the generation being computed changes */
+	u8 *tile_active;	/* tiles the generation being computed evaluates */
+	u64 tile_generations;	/* counted since the last resize */
+	u64 tiles_evaluated;
+	u32 tiles_last;		/* evaluated by the last generation */
+	struct gol_band *bands;
+	unsigned int nr_bands;
+	atomic_t bands_pending;
+	struct completion bands_done;
+	char *render;		/* PAGE_SIZE bounce buffer for read(2) */
+	u64 generation;
+	u64 frame;
+	struct gol_cycle cycle;
+	struct gol_history history;
+	struct gol_counters counters;
+	struct dentry *debugfs;
+	bool running;		/* GOL_RUN is ticking the board */
+	u32 run_rate;		/* generations per second */
+	ktime_t run_period;
+	struct hrtimer run_timer;
+	struct work_struct run_work;
+	ktime_t run_due;	/* expiry of the timer that queued run_work */
+	u64 run_generations;
+	atomic64_t run_overruns;
+	u64 run_late_ns;	/* sum over run_generations */
+	u64 run_late_max_ns;
+};
+
+/* Per open file */
+struct gol_file {
+	struct gol_info *data;
+	bool observer;		/* read-only, from GOL_OBSERVE */
+	bool wait;		/* read(2) waits for a frame newer than seen */
+	u64 seen;		/* frame returned by the last read(2) */
+	int format;		/* GOL_FORMAT_* used by read(2) */
+	int load;		/* GOL_LOAD_* used by write(2) */
+};
+
+static inline u32 *gol_row(struct gol_info *data, unsigned int row)
+{
+	return data->board + (size_t)row * data->words;
+}
+
+static inline int row_cell(const u32 *row, unsigned int col)
+{
+	return (row[col / 32] >> (col % 32)) & 1;
+}
+
+/*
+ * Marks @row as changed by the frame being built.  shared_end() publishes
+ * it, so the frame it will publish is the current one plus one.
+ */
+static inline void row_changed(struct gol_info *data, unsigned int row)
+{
+	data->row_frame[row] = data->frame + 1;
+	WRITE_ONCE(data->diff_frame, data->frame + 1);
+}
+
+static inline size_t nr_tiles(struct gol_info *data)
+{
+	return (size_t)data->tile_rows * data->words;
+}
+
+/* Makes the next generation evaluate every tile. */
+static inline void tiles_reset(struct gol_info *data)
+{
+	memset(data->tile_changed, 1, nr_tiles(data));
+}
+
+static void rule_compile(struct rule_table *rule, u16 birth, u16 survive)
+{
+	rule->birth = birth;
+	rule->survive = survive;
+	for (unsigned int i = 0; i < ARRAY_SIZE(rule->next); ++i) {
+		unsigned int neighbors = hweight16(i & ~BIT(4));
+		u16 set = i & BIT(4) ? survive : birth;
+
+		rule->next[i] = (set >> neighbors) & 1;
+	}
+}
+
+/* Parses a rule in B/S notation, as in "B36/S23". */
+static int rule_parse(const char *str, u16 *birth, u16 *survive)
+{
+	u16 *set = birth;
+
+	if (toupper(*str) != 'B')
+		return -EINVAL;
+
+	*birth = 0;
+	*survive = 0;
+	for (const char *p = str + 1; *p; ++p) {
+		if ('0' <= *p && *p <= '8') {
+			*set |= BIT(*p - '0');
+		} else if (set == birth && *p == '/' && toupper(p[1]) == 'S') {
+			set = survive;
+			++p;
+		} else {
+			return -EINVAL;
+		}
+	}
+	return set == survive ? 0 : -EINVAL;
+}
+
+/* Writes @rule in B/S notation, as in "B3/S23". */
+static int rule_format(const struct rule_table *rule, char *buf, size_t size)
+{
+	char b[10], s[10];
+	int nb = 0, ns = 0;
+
+	for (int n = 0; n <= 8; ++n) {
+		if (rule->birth & BIT(n))
+			b[nb++] = '0' + n;
+		if (rule->survive & BIT(n))
+			s[ns++] = '0' + n;
+	}
+	return snprintf(buf, size, "B%.*s/S%.*s", nb, b, ns, s);
+}
+
+static inline void cycle_reset(struct gol_info *data)
+{
+	data->cycle.depth = 0;
+	data->cycle.period = 0;
+	data->cycle.checked = U64_MAX;
+	data->cycle.candidate = 0;
+}
+
+/*
+ * The header page tells mmap(2) readers which buffer is the board.  Every
+ * change to it is bracketed by an odd seq, and it is published after every
+ * swap before the back buffer is written again, so a reader that sees the
+ * same even seq before and after copying the front buffer got a whole
+ * generation.
+ */
+static inline void shared_begin(struct gol_info *data)
+{
+	WRITE_ONCE(data->shared->seq, data->shared->seq + 1);
+	smp_wmb();
+}
+
+static inline void shared_end(struct gol_info *data)
+{
+	struct gol_shared *shared = data->shared;
+
+	shared->front = (void *)data->board != (void *)shared + shared->offset[0];
+	shared->generation = data->generation;
+	smp_wmb();
+	WRITE_ONCE(shared->seq, shared->seq + 1);
+	// The back buffer is the old front, keep the next tick's stores to it
+	// behind the seq that retires it.
+	smp_wmb();
+	WRITE_ONCE(data->frame, data->frame + 1);
+}
+
+static inline void gol_publish(struct gol_info *data)
+{
+	shared_begin(data);
+	shared_end(data);
+}
+
+/* Wakes the readers waiting for a new frame. */
+static inline void gol_notify(struct gol_info *data)
+{
+	if (wq_has_sleeper(&data->wait))
+		wake_up_interruptible_poll(&data->wait, EPOLLIN | EPOLLRDNORM);
+}
+
+static void tick_band_work(struct work_struct *work);
+static enum hrtimer_restart run_timer_fn(struct hrtimer *timer);
+static void run_work_fn(struct work_struct *work);
+static void run_stop(struct gol_info *data);
+
+static inline u32 *back_row(struct gol_info *data, unsigned int row)
+{
+	return data->back + (size_t)row * data->words;
+}
+
+static inline size_t board_size(unsigned int rows, unsigned int words)
+{
+	return array3_size(rows, words, sizeof(u32));
+}
+
+/* Largest history depth that keeps boards of @size bytes under the cap. */
+static inline unsigned int history_max_depth(size_t size)
+{
+	return min_t(u64, div64_u64((u64)READ_ONCE(history_max_mb) << 20, size),
+		     UINT_MAX);
+}
+
+static int history_alloc(struct gol_history *history, unsigned int depth,
+			 size_t size)
+{
+	history->depth = depth;
+	history->boards = NULL;
+	history->gen = NULL;
+	if (!depth)
+		return 0;
+
+	history->boards = kvmalloc_array(depth, size, GFP_KERNEL);
+	history->gen = kvmalloc_array(depth, sizeof(u64), GFP_KERNEL);
+	if (!history->boards || !history->gen) {
+		kvfree(history->boards);
+		kvfree(history->gen);
+		return -ENOMEM;
+	}
+	memset(history->gen, 0xff, depth * sizeof(u64));
+	return 0;
+}
+
+static void history_free(struct gol_history *history)
+{
+	kvfree(history->boards);
+	kvfree(history->gen);
+}
+
+/*
+ * Marks the rows the back buffer changes in [first, last) before it is
+ * swapped in.
+ */
+static void back_changed(struct gol_info *data, unsigned int first,
+			 unsigned int last)
+{
+	size_t row_size = data->words * sizeof(u32);
+
+	for (unsigned int i = first; i < last; ++i) {
+		if (memcmp(gol_row(data, i), back_row(data, i), row_size))
+			row_changed(data, i);
+	}
+}
+
+/*
+ * Replaces the board with an empty one of the given size.  The history
+ * keeps its depth as far as history_max_mb allows.
+ */
+static int gol_resize(struct gol_info *data, unsigned int rows,
+		      unsigned int cols)
+{
+	unsigned int words = DIV_ROUND_UP(cols, 32);
+	size_t buf_size = PAGE_ALIGN(board_size(rows, words));
+	unsigned int depth = min(data->history.depth,
+				 history_max_depth(board_size(rows, words)));
+	struct gol_history history;
+	struct gol_shared *shared;
+	unsigned int nr_bands;
+	struct gol_band *bands;
+	u64 *row_frame;
+	unsigned int tile_rows = DIV_ROUND_UP(rows, GOL_TILE_ROWS);
+	u8 *tiles;
+	u64 *tile_hash;
+	u32 *cycle_board;
+
+	nr_bands = min3(num_online_cpus(), (unsigned int)GOL_MAX_BANDS,
+			rows / GOL_MIN_BAND_ROWS);
+	nr_bands = max(nr_bands, 1U);
+
+	// Zeroed and mappable by remap_vmalloc_range()
+	shared = vmalloc_user(PAGE_SIZE + 2 * buf_size);
+	bands = kcalloc(nr_bands, sizeof(*bands), GFP_KERNEL);
+	row_frame = kvcalloc(rows, sizeof(*row_frame), GFP_KERNEL);
+	tiles = kvcalloc(3, (size_t)tile_rows * words, GFP_KERNEL);
+	tile_hash = kvcalloc((size_t)tile_rows * words, sizeof(u64), GFP_KERNEL);
+	cycle_board = kvmalloc(board_size(rows, words), GFP_KERNEL);
+	if (!shared || !bands || !row_frame || !tiles || !tile_hash ||
+	    !cycle_board ||
+	    history_alloc(&history, depth, board_size(rows, words))) {
+		vfree(shared);
+		kfree(bands);
+		kvfree(row_frame);
+		kvfree(tiles);
+		kvfree(tile_hash);
+		kvfree(cycle_board);
+		return -ENOMEM;
+	}
+
+	shared->rows = rows;
+	shared->columns = cols;
+	shared->words = words;
+	shared->offset[0] = PAGE_SIZE;
+	shared->offset[1] = PAGE_SIZE + buf_size;
+
+	for (unsigned int b = 0; b < nr_bands; ++b) {
+		INIT_WORK(&bands[b].work, tick_band_work);
+		bands[b].data = data;
+	}
+
+	vfree(data->shared);
+	kfree(data->bands);
+	kvfree(data->row_frame);
+	kvfree(data->tiles);
+	kvfree(data->cycle.tile_hash);
+	kvfree(data->cycle.board);
+	history_free(&data->history);
+	data->shared = shared;
+	data->board = (void *)shared + shared->offset[0];
+	data->back = (void *)shared + shared->offset[1];
+	data->bands = bands;
+	data->nr_bands = nr_bands;
+	data->rows = rows;
+	data->cols = cols;
+	data->words = words;
+	data->generation = 0;
+	data->history = history;
+	data->tile_rows = tile_rows;
+	data->tiles = tiles;
+	data->tile_changed = tiles;
+	data->tile_next = tiles + nr_tiles(data);
+	data->tile_active = tiles + 2 * nr_tiles(data);
+	data->cycle.tile_hash = tile_hash;
+	data->cycle.board = cycle_board;
+	data->tile_generations = 0;
+	data->tiles_evaluated = 0;
+	data->tiles_last = 0;
+	tiles_reset(data);
+	// Every row is new to every reader.
+	data->row_frame = row_frame;
+	for (unsigned int i = 0; i < rows; ++i)
+		row_changed(data, i);
+	WRITE_ONCE(data->frame, data->frame + 1);
+	cycle_reset(data);
+	return 0;
+}
+
+/* GOL_OBSERVE may still be looking at @data under RCU. */
+static void gol_free(struct gol_info *data)
+{
+	vfree(data->shared);
+	kfree(data->bands);
+	kvfree(data->row_frame);
+	kvfree(data->tiles);
+	kvfree(data->cycle.tile_hash);
+	kvfree(data->cycle.board);
+	history_free(&data->history);
+	kfree(data->render);
+	kfree_rcu(data, rcu);
+}
+
+static void gol_release(struct kref *ref)
+{
+	gol_free(container_of(ref, struct gol_info, ref));
+}
+
+static int board_stats_show(struct seq_file *m, void *v)
+{
+	struct gol_info *data = m->private;
+
+	mutex_lock(&data->lock);
+	seq_printf(m, "rows %u\ncolumns %u\ngeneration %llu\n", data->rows,
+		   data->cols, data->generation);
+	seq_printf(m, "generations %llu\nreads %llu\nread_bytes %llu\nwrites %llu\n",
+		   data->counters.generations, data->counters.reads,
+		   data->counters.read_bytes, data->counters.writes);
+	seq_printf(m, "tiles_evaluated %llu\n", data->tiles_evaluated);
+	mutex_unlock(&data->lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(board_stats);
+
+/* Ticks by duration, each line counting those from min_ns to the next. */
+static int tick_latency_show(struct seq_file *m, void *v)
+{
+	struct gol_info *data = m->private;
+
+	seq_puts(m, "min_ns ticks\n");
+	mutex_lock(&data->lock);
+	for (int b = 0; b < GOL_LATENCY_BUCKETS; ++b) {
+		u64 ticks = data->counters.tick_ns[b];
+
+		if (ticks)
+			seq_printf(m, "%llu %llu\n", b ? BIT_ULL(b - 1) : 0, ticks);
+	}
+	mutex_unlock(&data->lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(tick_latency);
+
+static void gol_debugfs_add(struct gol_info *data)
+{
+	char name[16];
+
+	snprintf(name, sizeof(name), "%d", data->owner);
+	data->debugfs = debugfs_create_dir(name, gol_debugfs);
+	debugfs_create_file("stats", 0444, data->debugfs, data,
+			    &board_stats_fops);
+	debugfs_create_file("tick_latency", 0444, data->debugfs, data,
+			    &tick_latency_fops);
+}
+
+/*
+ * Boards by the pid of the thread that opened them.  Lookups walk the xarray
+ * under RCU without taking any lock, insertion and removal only take the
+ * xarray's internal spinlock.
+ */
+static DEFINE_XARRAY(open_threads);
+
+/* Device file operations */
+int goldev_open(struct inode *inode, struct file *filep)
+{
+	pr_info("open called by thread %d\n", current->pid);
+
+	// Check if thread is on.
+	if (xa_load(&open_threads, current->pid)) {
+		pr_info("Thread %d already opened the device\n", current->pid);
+		return -EBUSY;
+	}
+
+	struct gol_file *gf = kzalloc(sizeof(struct gol_file), GFP_KERNEL);
+	struct gol_info *data = kzalloc(sizeof(struct gol_info), GFP_KERNEL);
+
+	if (!gf || !data) {
+		printk(KERN_ERR "Memory allocation failed\n");
+		kfree(gf);
+		kfree(data);
+		return -ENOMEM;
+	}
+
+	kref_init(&data->ref);
+	init_waitqueue_head(&data->wait);
+	mutex_init(&data->lock);
+	mutex_init(&data->map_lock);
+	data->live_cell = '*';
+	rule_compile(&data->rule, GOL_CONWAY_BIRTH, GOL_CONWAY_SURVIVE);
+	data->dead_cell = ' ';
+	data->owner = current->pid;
+	init_completion(&data->bands_done);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(&data->run_timer, run_timer_fn, CLOCK_MONOTONIC,
+		      HRTIMER_MODE_REL);
+#else
+	hrtimer_init(&data->run_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	data->run_timer.function = run_timer_fn;
+#endif
+	INIT_WORK(&data->run_work, run_work_fn);
+	data->render = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!data->render || gol_resize(data, ROWS, COLUMNS)) {
+		gol_free(data);
+		kfree(gf);
+		return -ENOMEM;
+	}
+
+	// Since the current thread isn't working add it to the registry, this
+	// fails with -EBUSY if it raced with another open of the same thread.
+	int ret = xa_insert(&open_threads, data->owner, data, GFP_KERNEL);
+
+	if (ret) {
+		gol_free(data);
+		kfree(gf);
+		return ret;
+	}
+
+	gol_debugfs_add(data);
+	gf->data = data;
+	filep->private_data = (void *)(gf);
+	return 0;
+}
+
+int goldev_close(struct inode *inode, struct file *filep)
+{
+	struct gol_file *gf = filep->private_data;
+
+	if (gf) {
+		struct gol_info *data = gf->data;
+
+		pr_info("Device released by thread\n");
+
+		if (!gf->observer) {
+			// Before the thread can open a board under the same
+			// name again.
+			debugfs_remove(data->debugfs);
+
+			// The board is registered under the thread that opened
+			// it, which need not be the one closing it.
+			xa_cmpxchg(&open_threads, data->owner, data, NULL, GFP_KERNEL);
+
+			// No more frames will come.
+			run_stop(data);
+			WRITE_ONCE(data->detached, true);
+			wake_up_interruptible_poll(&data->wait, EPOLLHUP);
+		}
+
+		// Observers may keep the board alive.
+		kref_put(&data->ref, gol_release);
+		kfree(gf);
+		filep->private_data = NULL;
+	}
+	return 0;
+}
+
+extern struct file_operations goldev_fops;
+
+/*
+ * Returns a read-only file on the board of thread @pid.  The xarray entry is
+ * only removed before the last reference is dropped, so a board found under
+ * RCU is either still alive or has a zero count.
+ */
+static long gol_observe(pid_t pid)
+{
+	struct gol_info *data;
+	struct gol_file *gf;
+	int fd;
+
+	rcu_read_lock();
+	data = xa_load(&open_threads, pid);
+	if (data && !kref_get_unless_zero(&data->ref))
+		data = NULL;
+	rcu_read_unlock();
+
+	if (!data)
+		return -ESRCH;
+
+	gf = kzalloc(sizeof(*gf), GFP_KERNEL);
+	if (!gf) {
+		kref_put(&data->ref, gol_release);
+		return -ENOMEM;
+	}
+	gf->data = data;
+	gf->observer = true;
+
+	fd = anon_inode_getfd(DEVNAME, &goldev_fops, gf, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		kfree(gf);
+		kref_put(&data->ref, gol_release);
+	}
+	return fd;
+}
+
+/*
+ * The rendered frame can be far larger than what fits on the kernel stack, so
+ * it is produced a page at a time into data->render and copied out whenever
+ * the page fills up.  Output past @limit bytes fails the read with -EINVAL.
+ */
+struct render_ctx {
+	char *page;
+	size_t fill;
+	char __user *dst;
+	size_t copied;
+	size_t limit;
+	int err;
+};
+
+static void render_flush(struct render_ctx *ctx)
+{
+	if (!ctx->err && copy_to_user(ctx->dst + ctx->copied, ctx->page, ctx->fill))
+		ctx->err = -EFAULT;
+	ctx->copied += ctx->fill;
+	ctx->fill = 0;
+}
+
+static inline void render_put(struct render_ctx *ctx, char c)
+{
+	if (ctx->copied + ctx->fill >= ctx->limit) {
+		ctx->err = -EINVAL;
+		return;
+	}
+	ctx->page[ctx->fill++] = c;
+	if (ctx->fill == PAGE_SIZE)
+		render_flush(ctx);
+}
+
+static void render_write(struct render_ctx *ctx, const void *src, size_t len)
+{
+	const char *p = src;
+
+	while (len) {
+		size_t n = min(len, PAGE_SIZE - ctx->fill);
+
+		memcpy(ctx->page + ctx->fill, p, n);
+		ctx->fill += n;
+		p += n;
+		len -= n;
+		if (ctx->fill == PAGE_SIZE)
+			render_flush(ctx);
+	}
+}
+
+static inline size_t frame_size(struct gol_info *data)
+{
+	return GOL_GRID_STRING_SIZE((size_t)data->rows, (size_t)data->cols);
+}
+
+static void render_text(struct gol_info *data, struct render_ctx *ctx)
+{
+	for (unsigned int j = 0; j < data->cols + 2; ++j)
+		render_put(ctx, '-');
+	render_put(ctx, '\n');
+
+	for (unsigned int i = 0; i < data->rows; ++i) {
+		const u32 *row = gol_row(data, i);
+
+		render_put(ctx, '|');
+		for (unsigned int j = 0; j < data->cols; ++j)
+			render_put(ctx, row_cell(row, j) ? data->live_cell : data->dead_cell);
+		render_put(ctx, '|');
+		render_put(ctx, '\n');
+	}
+
+	for (unsigned int j = 0; j < data->cols + 2; ++j)
+		render_put(ctx, '-');
+	render_put(ctx, '\n');
+	render_put(ctx, '\0');
+}
+
+/* Rows are copied a word at a time, in little-endian byte order. */
+static void render_bitmap(struct gol_info *data, const u32 *board,
+			  struct render_ctx *ctx)
+{
+	size_t row_bytes = DIV_ROUND_UP(data->cols, 8);
+
+	for (unsigned int i = 0; i < data->rows; ++i) {
+		const u32 *row = board + (size_t)i * data->words;
+		size_t left = row_bytes;
+
+		for (unsigned int k = 0; k < data->words; ++k) {
+			__le32 word = cpu_to_le32(row[k]);
+			size_t n = min_t(size_t, left, sizeof(word));
+
+			render_write(ctx, &word, n);
+			left -= n;
+		}
+	}
+}
+
+/*
+ * Rows that changed since frame @seen, each as its index and its words, all
+ * in little-endian byte order.
+ */
+static void render_diff(struct gol_info *data, struct render_ctx *ctx,
+			u64 seen)
+{
+	for (unsigned int i = 0; i < data->rows; ++i) {
+		const u32 *row = gol_row(data, i);
+		__le32 word;
+
+		if (data->row_frame[i] <= seen)
+			continue;
+
+		word = cpu_to_le32(i);
+		render_write(ctx, &word, sizeof(word));
+		for (unsigned int k = 0; k < data->words; ++k) {
+			word = cpu_to_le32(row[k]);
+			render_write(ctx, &word, sizeof(word));
+		}
+	}
+}
+
+/*
+ * First column at or after @col whose cell differs from the one at @col, or
+ * @cols if the run reaches the end of the row.  Padding bits are clear, so a
+ * dead run never stops inside them and a live one stops at the first.
+ */
+static unsigned int run_end(const u32 *row, unsigned int col,
+			    unsigned int cols)
+{
+	u32 flip = row_cell(row, col) ? ~0U : 0;
+	unsigned int k = col / 32;
+	u32 diff = (row[k] ^ flip) & (~0U << (col % 32));
+
+	while (!diff) {
+		if (++k * 32 >= cols)
+			return cols;
+		diff = row[k] ^ flip;
+	}
+	return min(k * 32 + __ffs(diff), cols);
+}
+
+/* Lines of a pattern file should not be longer than 70 characters. */
+#define GOL_RLE_LINE (70)
+
+struct rle_ctx {
+	struct render_ctx *out;
+	unsigned int line;
+};
+
+/* Emits a run of @n tags @tag, breaking the line before it if needed. */
+static void rle_put(struct rle_ctx *rle, unsigned int n, char tag)
+{
+	char buf[12];
+	int len = 0;
+
+	if (n > 1)
+		len = snprintf(buf, sizeof(buf), "%u", n);
+	buf[len++] = tag;
+
+	if (rle->line + len > GOL_RLE_LINE) {
+		render_put(rle->out, '\n');
+		rle->line = 0;
+	}
+	for (int i = 0; i < len; ++i)
+		render_put(rle->out, buf[i]);
+	rle->line += len;
+}
+
+/*
+ * Runs are found a word at a time.  Dead runs at the end of a row are left
+ * out, as are empty rows at the end of the board, and consecutive ends of
+ * row are merged into a single counted $.
+ */
+static void render_rle(struct gol_info *data, struct render_ctx *ctx)
+{
+	struct rle_ctx rle = { .out = ctx };
+	unsigned int pending_rows = 0;
+	char header[64], rule[24];
+	int len;
+
+	rule_format(&data->rule, rule, sizeof(rule));
+	len = snprintf(header, sizeof(header), "x = %u, y = %u, rule = %s\n",
+		       data->cols, data->rows, rule);
+	for (int i = 0; i < len; ++i)
+		render_put(ctx, header[i]);
+
+	for (unsigned int i = 0; i < data->rows; ++i) {
+		const u32 *row = gol_row(data, i);
+		unsigned int col = 0;
+
+		while (col < data->cols) {
+			unsigned int start = col;
+			unsigned int end = run_end(row, col, data->cols);
+			bool alive = row_cell(row, col);
+
+			col = end;
+			if (!alive && end == data->cols)
+				break;
+
+			if (pending_rows) {
+				rle_put(&rle, pending_rows, '$');
+				pending_rows = 0;
+			}
+			rle_put(&rle, end - start, alive ? 'o' : 'b');
+		}
+		++pending_rows;
+	}
+
+	rle_put(&rle, 1, '!');
+	render_put(ctx, '\n');
+}
+
+/* Renders the board in the format @gf selected into @ctx. */
+static int render_board(struct gol_file *gf, struct render_ctx *ctx,
+			size_t count)
+{
+	struct gol_info *data = gf->data;
+
+	switch (gf->format) {
+	case GOL_FORMAT_BITMAP:
+		if (count < GOL_BITMAP_SIZE((size_t)data->rows, data->cols))
+			return -EINVAL;
+		render_bitmap(data, data->board, ctx);
+		break;
+	case GOL_FORMAT_RLE:
+		render_rle(data, ctx);
+		break;
+	case GOL_FORMAT_DIFF:
+		if (count < GOL_DIFF_SIZE((size_t)data->rows, data->cols))
+			return -EINVAL;
+		render_diff(data, ctx, gf->seen);
+		break;
+	default:
+		// A count of 0 asks for the whole frame, like it always did.
+		if (count && count < frame_size(data))
+			return -EINVAL;
+		ctx->limit = SIZE_MAX;
+		render_text(data, ctx);
+		break;
+	}
+	render_flush(ctx);
+	return ctx->err;
+}
+
+/*
+ * Newest frame a read(2) of @gf returns something for.  Frames that change
+ * no row, a still life or GOL_LIVE, leave nothing to diff.
+ */
+static inline u64 ready_frame(struct gol_file *gf)
+{
+	if (gf->format == GOL_FORMAT_DIFF)
+		return READ_ONCE(gf->data->diff_frame);
+	return READ_ONCE(gf->data->frame);
+}
+
+static inline bool frame_ready(struct gol_file *gf)
+{
+	return ready_frame(gf) > gf->seen || READ_ONCE(gf->data->detached);
+}
+
+ssize_t goldev_read(struct file *filep, char *__user buf, size_t count,
+		    loff_t *fpos)
+{
+	struct gol_file *gf = (struct gol_file *)filep->private_data;
+	struct gol_info *data = gf->data;
+	struct render_ctx ctx = { .page = data->render, .dst = buf,
+				  .limit = count };
+	int ret;
+
+	if (gf->wait) {
+		if ((filep->f_flags & O_NONBLOCK) && !frame_ready(gf))
+			return -EAGAIN;
+		if (wait_event_interruptible(data->wait, frame_ready(gf)))
+			return -ERESTARTSYS;
+	}
+
+	mutex_lock(&data->lock);
+
+	// Nothing new and nothing coming, end of file.
+	if (gf->wait && ready_frame(gf) <= gf->seen) {
+		mutex_unlock(&data->lock);
+		return 0;
+	}
+
+	ret = render_board(gf, &ctx, count);
+	if (!ret) {
+		gf->seen = data->frame;
+		data->counters.reads++;
+		data->counters.read_bytes += ctx.copied;
+	}
+	mutex_unlock(&data->lock);
+
+	if (ret)
+		return ret;
+
+	trace_gol_read(data->owner, gf->format, ctx.copied);
+	return ctx.copied;
+}
+
+/* Readable while there is a frame this file has not read and can diff. */
+static __poll_t goldev_poll(struct file *filep, poll_table *wait)
+{
+	struct gol_file *gf = (struct gol_file *)filep->private_data;
+	__poll_t mask = 0;
+
+	poll_wait(filep, &gf->data->wait, wait);
+
+	if (ready_frame(gf) > gf->seen)
+		mask |= EPOLLIN | EPOLLRDNORM;
+	if (READ_ONCE(gf->data->detached))
+		mask |= EPOLLHUP;
+	return mask;
+}
+
+/*
+ * Patterns are parsed a page at a time straight into the back buffer, which
+ * only becomes the board once the whole write was parsed successfully.
+ * Otherwise it is copied back from the board, since ticks leave the back
+ * buffer's inactive tiles as they are.
+ */
+enum {
+	LOAD_LINE,		/* at the start of a line */
+	LOAD_COMMENT,		/* skipping a # line */
+	LOAD_TEXT,		/* collecting a line into @line */
+	LOAD_BODY,		/* RLE runs */
+	LOAD_DONE,		/* RLE past the final ! */
+};
+
+struct gol_load {
+	struct gol_info *data;
+	int format;		/* GOL_LOAD_* */
+	int state;
+	bool header;		/* RLE "x = ..." line seen */
+	unsigned int width;	/* RLE pattern size */
+	unsigned int height;
+	unsigned int row;
+	unsigned int col;	/* byte of the row for bitmaps */
+	unsigned int run;	/* RLE run count, 0 if none was given */
+	unsigned int len;
+	char line[64];
+};
+
+static inline void load_cell(struct gol_info *data, unsigned int row,
+			     unsigned int col)
+{
+	back_row(data, row)[col / 32] |= BIT(col % 32);
+}
+
+static int load_bitmap(struct gol_load *ld, const void *buf, size_t n)
+{
+	struct gol_info *data = ld->data;
+	const u8 *src = buf;
+	unsigned int row_bytes = DIV_ROUND_UP(data->cols, 8);
+
+	for (size_t i = 0; i < n; ++i) {
+		if (ld->row == data->rows)
+			return -EINVAL;
+
+		back_row(data, ld->row)[ld->col / 4] |= (u32)src[i] << (ld->col % 4 * 8);
+		if (++ld->col == row_bytes) {
+			// Bits past the last column must stay clear.
+			back_row(data, ld->row)[data->words - 1] &=
+				GENMASK((data->cols - 1) % 32, 0);
+			ld->col = 0;
+			++ld->row;
+		}
+	}
+	return 0;
+}
+
+/* Parses the line collected in @ld->line. */
+static int load_line(struct gol_load *ld)
+{
+	struct gol_info *data = ld->data;
+	int x, y;
+	char extra;
+
+	ld->line[ld->len] = '\0';
+	ld->len = 0;
+
+	if (ld->format == GOL_LOAD_RLE) {
+		if (sscanf(ld->line, "x = %u , y = %u", &ld->width, &ld->height) != 2 ||
+		    ld->width > data->cols || ld->height > data->rows)
+			return -EINVAL;
+		ld->header = true;
+		ld->state = LOAD_BODY;
+		return 0;
+	}
+
+	ld->state = LOAD_LINE;
+	if (!*skip_spaces(ld->line))
+		return 0;
+	if (sscanf(ld->line, "%d %d %c", &x, &y, &extra) != 2)
+		return -EINVAL;
+
+	x %= (int)data->cols;
+	y %= (int)data->rows;
+	load_cell(data, y < 0 ? y + data->rows : y, x < 0 ? x + data->cols : x);
+	return 0;
+}
+
+static int load_rle_tag(struct gol_load *ld, char c)
+{
+	unsigned int n = ld->run ? ld->run : 1;
+
+	ld->run = 0;
+	switch (c) {
+	case 'b':
+	case 'o':
+		if (n > ld->width - ld->col || ld->row >= ld->height)
+			return -EINVAL;
+		if (c == 'o') {
+			for (unsigned int j = ld->col; j < ld->col + n; ++j)
+				load_cell(ld->data, ld->row, j);
+		}
+		ld->col += n;
+		return 0;
+	case '$':
+		if (n > ld->height - ld->row)
+			return -EINVAL;
+		ld->row += n;
+		ld->col = 0;
+		return 0;
+	case '!':
+		ld->state = LOAD_DONE;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int load_text(struct gol_load *ld, const char *src, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		char c = src[i];
+
+		switch (ld->state) {
+		case LOAD_LINE:
+			if (c == '#') {
+				ld->state = LOAD_COMMENT;
+				break;
+			}
+			if (c == '\n')
+				break;
+			ld->state = LOAD_TEXT;
+			fallthrough;
+		case LOAD_TEXT:
+			if (c == '\n') {
+				int ret = load_line(ld);
+
+				if (ret)
+					return ret;
+				break;
+			}
+			if (ld->len == sizeof(ld->line) - 1)
+				return -EINVAL;
+			ld->line[ld->len++] = c;
+			break;
+		case LOAD_COMMENT:
+			if (c == '\n')
+				ld->state = LOAD_LINE;
+			break;
+		case LOAD_BODY:
+			if (isdigit(c)) {
+				if (ld->run > GOL_MAX_ROWS * GOL_MAX_COLUMNS)
+					return -EINVAL;
+				ld->run = ld->run * 10 + (c - '0');
+			} else if (!isspace(c)) {
+				int ret = load_rle_tag(ld, c);
+
+				if (ret)
+					return ret;
+			}
+			break;
+		case LOAD_DONE:
+			break;
+		}
+	}
+	return 0;
+}
+
+static int load_finish(struct gol_load *ld)
+{
+	switch (ld->format) {
+	case GOL_LOAD_BITMAP:
+		return ld->row == ld->data->rows ? 0 : -EINVAL;
+	case GOL_LOAD_RLE:
+		if (ld->state == LOAD_TEXT && load_line(ld))
+			return -EINVAL;
+		return ld->header && !ld->run ? 0 : -EINVAL;
+	default:
+		return ld->state == LOAD_TEXT ? load_line(ld) : 0;
+	}
+}
+
+static ssize_t load_board(struct gol_info *data, int format,
+			  const char __user *buf, size_t count)
+{
+	struct gol_load ld = { .data = data, .format = format,
+			       .state = LOAD_LINE };
+	size_t size = array3_size(data->rows, data->words, sizeof(u32));
+	size_t done = 0;
+	int ret = 0;
+
+	memset(data->back, 0, size);
+
+	while (!ret && done < count) {
+		size_t n = min_t(size_t, count - done, PAGE_SIZE);
+
+		if (copy_from_user(data->render, buf + done, n)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		if (format == GOL_LOAD_BITMAP)
+			ret = load_bitmap(&ld, data->render, n);
+		else
+			ret = load_text(&ld, data->render, n);
+		done += n;
+
+		if (fatal_signal_pending(current)) {
+			ret = -EINTR;
+			break;
+		}
+		cond_resched();
+	}
+	if (!ret)
+		ret = load_finish(&ld);
+	if (ret) {
+		memcpy(data->back, data->board, size);
+		return ret;
+	}
+
+	back_changed(data, 0, data->rows);
+	swap(data->board, data->back);
+	tiles_reset(data);
+	cycle_reset(data);
+	gol_publish(data);
+	return count;
+}
+
+static ssize_t toggle_cell(struct gol_info *data, loff_t *fpos)
+{
+	loff_t cells = (loff_t)data->rows * data->cols;
+
+	if ((*fpos) < 0 || cells <= (*fpos))
+		return -EPERM;
+
+	unsigned int col;
+	unsigned int row = div_u64_rem(*fpos, data->cols, &col);
+
+	shared_begin(data);
+	gol_row(data, row)[col / 32] ^= BIT(col % 32);
+	row_changed(data, row);
+	data->tile_changed[row / GOL_TILE_ROWS * data->words + col / 32] = 1;
+	shared_end(data);
+	cycle_reset(data);
+	(*fpos) += 1;
+	return 0;
+}
+
+ssize_t goldev_write(struct file *filep, const char *__user buf, size_t count,
+		     loff_t *fpos)
+{
+	struct gol_file *gf = (struct gol_file *)filep->private_data;
+	struct gol_info *data = gf->data;
+	loff_t pos = *fpos;
+	ssize_t ret;
+
+	if (gf->observer)
+		return -EPERM;
+
+	mutex_lock(&data->lock);
+	data->counters.writes++;
+	if (gf->load != GOL_LOAD_TOGGLE)
+		ret = load_board(data, gf->load, buf, count);
+	else
+		ret = toggle_cell(data, fpos);
+	mutex_unlock(&data->lock);
+
+	if (ret < 0)
+		return ret;
+
+	trace_gol_write(data->owner, pos, count);
+	gol_notify(data);
+	return ret;
+}
+
+static loff_t goldev_llseek(struct file *filep, loff_t off, int whence)
+{
+	struct gol_file *gf = (struct gol_file *)filep->private_data;
+	struct gol_info *data = gf->data;
+	loff_t last;
+	loff_t retval;
+
+	trace_gol_llseek(data->owner, off, whence);
+
+	mutex_lock(&data->lock);
+	last = (loff_t)data->rows * data->cols - 1;
+	mutex_unlock(&data->lock);
+
+	switch (whence) {
+	case SEEK_SET:
+		retval = off;
+		break;
+	case SEEK_CUR:
+		retval = filep->f_pos + off;
+		break;
+	case SEEK_END:
+		retval = last + off;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (retval > last)
+		return -EPERM;
+
+	return (filep->f_pos = retval);
+}
+
+/* The cells of column @col from north to south, as in rule_table.next[]. */
+static inline unsigned int column_bits(const u32 *up, const u32 *mid,
+				       const u32 *down, unsigned int col)
+{
+	return row_cell(up, col) << 2 | row_cell(mid, col) << 1 |
+	       row_cell(down, col);
+}
+
+/*
+ * Slides a 3x3 window along the row, shifting in the column east of each
+ * cell, and looks the cell's next state up in the rule's table.
+ */
+static void next_row_scalar(struct gol_info *data, const u32 *up,
+			    const u32 *mid, const u32 *down, u32 *out)
+{
+	const u8 *next = data->rule.next;
+	unsigned int cols = data->cols;
+	unsigned int window = column_bits(up, mid, down, cols - 1) << 3 |
+			      column_bits(up, mid, down, 0);
+
+	memset(out, 0, data->words * sizeof(u32));
+
+	for (unsigned int j = 0; j < cols; ++j) {
+		unsigned int east = j + 1 < cols ? j + 1 : 0;
+
+		window = (window << 3 | column_bits(up, mid, down, east)) & 0x1ff;
+		out[j / 32] |= (u32)next[window] << (j % 32);
+	}
+}
+
+/*
+ * Marks the tiles of @row whose words the next generation changes in @next,
+ * the row's slice of tile_next, and returns whether any did.  Words of
+ * tiles that are not @active were not evaluated and did not change.
+ */
+static bool row_tiles_changed(struct gol_info *data, unsigned int row,
+			      const u8 *active, u8 *next)
+{
+	const u32 *cur = gol_row(data, row);
+	const u32 *new = back_row(data, row);
+	bool changed = false;
+
+	for (unsigned int k = 0; k < data->words; ++k) {
+		if (active && !active[k])
+			continue;
+		if (cur[k] != new[k]) {
+			// Bands may share a row of tiles.
+			WRITE_ONCE(next[k], 1);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+/* Computes the band's rows of the back buffer from the current board. */
+static void tick_band(struct gol_band *band)
+{
+	struct gol_info *data = band->data;
+	unsigned int rows = data->rows;
+
+	for (unsigned int i = band->first; i < band->last; ++i) {
+		const u32 *up = gol_row(data, (i + rows - 1) % rows);
+		const u32 *mid = gol_row(data, i);
+		const u32 *down = gol_row(data, (i + 1) % rows);
+		size_t tile = (size_t)(i / GOL_TILE_ROWS) * data->words;
+		const u8 *active = band->scalar ? NULL : data->tile_active + tile;
+
+		if (band->scalar)
+			next_row_scalar(data, up, mid, down, back_row(data, i));
+		else
+			gol_next_row(up, mid, down, back_row(data, i), data->cols,
+				     active, data->rule.birth, data->rule.survive);
+
+		// While both rows are still in the cache.
+		if (row_tiles_changed(data, i, active, data->tile_next + tile))
+			row_changed(data, i);
+	}
+}
+
+static void tick_band_work(struct work_struct *work)
+{
+	struct gol_band *band = container_of(work, struct gol_band, work);
+
+	tick_band(band);
+	if (atomic_dec_and_test(&band->data->bands_pending))
+		complete(&band->data->bands_done);
+}
+
+/*
+ * Marks the tiles that changed in the last generation and their neighbors
+ * as active and returns how many there are.
+ */
+static u32 tiles_prepare(struct gol_info *data)
+{
+	unsigned int tile_rows = data->tile_rows;
+	unsigned int words = data->words;
+	u32 count = 0;
+
+	memset(data->tile_active, 0, nr_tiles(data));
+	for (unsigned int r = 0; r < tile_rows; ++r) {
+		for (unsigned int k = 0; k < words; ++k) {
+			if (!data->tile_changed[r * words + k])
+				continue;
+
+			for (int dr = -1; dr <= 1; ++dr) {
+				u8 *row = data->tile_active +
+					  (r + tile_rows + dr) % tile_rows * words;
+
+				for (int dk = -1; dk <= 1; ++dk)
+					row[(k + words + dk) % words] = 1;
+			}
+		}
+	}
+
+	for (size_t t = 0; t < nr_tiles(data); ++t)
+		count += data->tile_active[t];
+	return count;
+}
+
+/*
+ * Bands only read the current board and only write their own rows of the
+ * back buffer, so the result does not depend on the split.  The caller
+ * ticks the first band itself and waits for the others, then the buffers
+ * are swapped.  The scalar engine evaluates every tile.
+ */
+static void update_board(struct gol_info *data)
+{
+	bool scalar = READ_ONCE(engine) == GOL_ENGINE_SCALAR;
+	unsigned int nr_bands = data->nr_bands;
+	u32 evaluated = scalar ? nr_tiles(data) : tiles_prepare(data);
+
+	data->tiles_last = evaluated;
+	data->tiles_evaluated += evaluated;
+	data->tile_generations++;
+
+	// Nothing can change, and the back buffer already matches the board.
+	if (!evaluated)
+		return;
+
+	memset(data->tile_next, 0, nr_tiles(data));
+
+	if ((u64)data->rows * data->cols < READ_ONCE(parallel_min_cells))
+		nr_bands = 1;
+
+	for (unsigned int b = 0; b < nr_bands; ++b) {
+		struct gol_band *band = &data->bands[b];
+
+		band->first = data->rows * b / nr_bands;
+		band->last = data->rows * (b + 1) / nr_bands;
+		band->scalar = scalar;
+	}
+
+	if (nr_bands > 1) {
+		reinit_completion(&data->bands_done);
+		atomic_set(&data->bands_pending, nr_bands - 1);
+		for (unsigned int b = 1; b < nr_bands; ++b)
+			queue_work(gol_band_wq, &data->bands[b].work);
+	}
+
+	tick_band(&data->bands[0]);
+
+	if (nr_bands > 1)
+		wait_for_completion(&data->bands_done);
+
+	swap(data->board, data->back);
+	swap(data->tile_changed, data->tile_next);
+}
+
+/*
+ * Hashlife engine
+ *
+ * The torus is unrolled into the periodic plane it tiles, so a power of two
+ * board stays a square tile of side 2^k (at least one leaf) that the
+ * memoized quadtree can advance by 2^j generations at a time.  Nodes are
+ * hash-consed in a single cache shared by all open files.  A node holds a
+ * reference on its children and on its memoized results; unreferenced nodes
+ * sit on an LRU list and are evicted, oldest first, whenever the cache grows
+ * past hashlife_max_mb.  Eviction only runs between steps, when the tile
+ * being advanced is the only live root, so within a step no node is
+ * allocated past the cap: the step fails and is retried as a smaller one
+ * once everything unreferenced was evicted.
+ */
+#define HL_LEAF_LEVEL (3)	/* 8x8 cells, bit 8 * y + x of bits */
+#define HL_BASE_LEVEL (5)	/* 32x32 nodes are advanced cell by cell */
+#define HL_MAX_STEP (30)	/* largest single step, bounds the recursion */
+
+/*
+ * Fewer generations are left to the dense engines, building the tree from
+ * the board and storing it back costs more than ticking them.
+ */
+#define HL_MIN_GENERATIONS (64)
+
+static unsigned int hashlife_max_mb = 64;
+module_param(hashlife_max_mb, uint, 0644);
+MODULE_PARM_DESC(hashlife_max_mb, "Memory cap of the Hashlife node cache in MiB");
+
+struct hl_node {
+	struct hlist_node hash;
+	struct list_head lru;		/* on hashlife.lru while unreferenced */
+	union {
+		struct hl_node *child[4];	/* nw, ne, sw, se */
+		u64 bits;			/* leaves */
+	};
+	struct hl_node *result;		/* centre 2^(level - 2) generations on */
+	struct hl_node *step_result;	/* centre 2^step_j generations on */
+	unsigned int refs;
+	u8 level;
+	u8 step_j;
+	bool alive;
+};
+
+static struct {
+	struct mutex lock;
+	struct kmem_cache *slab;
+	struct hlist_head *table;
+	unsigned int bits;
+	unsigned long nodes;
+	struct list_head lru;
+} hashlife;
+
+static unsigned long hl_max_nodes(void)
+{
+	return ((unsigned long)READ_ONCE(hashlife_max_mb) << 20) /
+	       sizeof(struct hl_node);
+}
+
+static int hl_init(void)
+{
+	if (hashlife.table)
+		return 0;
+
+	hashlife.slab = kmem_cache_create("gol_hashlife", sizeof(struct hl_node),
+					  0, 0, NULL);
+	if (!hashlife.slab)
+		return -ENOMEM;
+
+	// Size the table for the cap at the time of first use.
+	hashlife.bits = clamp_t(unsigned int, ilog2(hl_max_nodes() | 1), 10, 22);
+	hashlife.table = kvcalloc(1UL << hashlife.bits, sizeof(*hashlife.table),
+				  GFP_KERNEL);
+	if (!hashlife.table) {
+		kmem_cache_destroy(hashlife.slab);
+		hashlife.slab = NULL;
+		return -ENOMEM;
+	}
+
+	INIT_LIST_HEAD(&hashlife.lru);
+	return 0;
+}
+
+static void hl_get(struct hl_node *n)
+{
+	if (!n->refs++)
+		list_del_init(&n->lru);
+}
+
+static void hl_put(struct hl_node *n)
+{
+	if (!--n->refs)
+		list_add_tail(&n->lru, &hashlife.lru);
+}
+
+static void hl_touch(struct hl_node *n)
+{
+	if (!n->refs)
+		list_move_tail(&n->lru, &hashlife.lru);
+}
+
+static struct hl_node *hl_new(struct hlist_head *bucket, u8 level)
+{
+	struct hl_node *n;
+
+	if (hashlife.nodes >= hl_max_nodes())
+		return NULL;
+
+	n = kmem_cache_zalloc(hashlife.slab, GFP_KERNEL);
+	if (!n)
+		return NULL;
+
+	n->level = level;
+	hlist_add_head(&n->hash, bucket);
+	list_add_tail(&n->lru, &hashlife.lru);
+	hashlife.nodes++;
+	return n;
+}
+
+static void hl_free(struct hl_node *n)
+{
+	hlist_del(&n->hash);
+	list_del(&n->lru);
+	if (n->level > HL_LEAF_LEVEL) {
+		for (int i = 0; i < 4; ++i)
+			hl_put(n->child[i]);
+	}
+	if (n->result)
+		hl_put(n->result);
+	if (n->step_result)
+		hl_put(n->step_result);
+	kmem_cache_free(hashlife.slab, n);
+	hashlife.nodes--;
+}
+
+/* Frees unreferenced nodes, oldest first, until at most @max_nodes are left. */
+static void hl_evict(unsigned long max_nodes)
+{
+	while (hashlife.nodes > max_nodes && !list_empty(&hashlife.lru))
+		hl_free(list_first_entry(&hashlife.lru, struct hl_node, lru));
+}
+
+static void hl_destroy(void)
+{
+	struct hl_node *n;
+	struct hlist_node *tmp;
+
+	if (!hashlife.table)
+		return;
+
+	for (unsigned long i = 0; i < (1UL << hashlife.bits); ++i) {
+		hlist_for_each_entry_safe(n, tmp, &hashlife.table[i], hash)
+			kmem_cache_free(hashlife.slab, n);
+	}
+	kvfree(hashlife.table);
+	kmem_cache_destroy(hashlife.slab);
+	hashlife.table = NULL;
+	hashlife.nodes = 0;
+}
+
+static struct hl_node *hl_leaf(u64 bits)
+{
+	struct hlist_head *bucket = &hashlife.table[hash_64(bits, hashlife.bits)];
+	struct hl_node *n;
+
+	hlist_for_each_entry(n, bucket, hash) {
+		if (n->level == HL_LEAF_LEVEL && n->bits == bits) {
+			hl_touch(n);
+			return n;
+		}
+	}
+
+	n = hl_new(bucket, HL_LEAF_LEVEL);
+	if (!n)
+		return NULL;
+	n->bits = bits;
+	n->alive = bits != 0;
+	return n;
+}
+
+static struct hl_node *hl_join(struct hl_node *nw, struct hl_node *ne,
+			       struct hl_node *sw, struct hl_node *se)
+{
+	u64 key = (unsigned long)nw;
+	struct hlist_head *bucket;
+	struct hl_node *n;
+
+	if (!nw || !ne || !sw || !se)
+		return NULL;
+
+	key = key * 31 + (unsigned long)ne;
+	key = key * 31 + (unsigned long)sw;
+	key = key * 31 + (unsigned long)se;
+	bucket = &hashlife.table[hash_64(key, hashlife.bits)];
+
+	hlist_for_each_entry(n, bucket, hash) {
+		if (n->level == nw->level + 1 && n->child[0] == nw &&
+		    n->child[1] == ne && n->child[2] == sw && n->child[3] == se) {
+			hl_touch(n);
+			return n;
+		}
+	}
+
+	n = hl_new(bucket, nw->level + 1);
+	if (!n)
+		return NULL;
+	n->child[0] = nw;
+	n->child[1] = ne;
+	n->child[2] = sw;
+	n->child[3] = se;
+	for (int i = 0; i < 4; ++i)
+		hl_get(n->child[i]);
+	n->alive = nw->alive || ne->alive || sw->alive || se->alive;
+	return n;
+}
+
+/* The level - 1 node centred in @n, for nodes above the base level */
+static struct hl_node *hl_centre(struct hl_node *n)
+{
+	return hl_join(n->child[0]->child[3], n->child[1]->child[2],
+		       n->child[2]->child[1], n->child[3]->child[0]);
+}
+
+/* ORs the cells of @n into @rows with its top-left corner at (@y, @x). */
+static void hl_to_rows(struct hl_node *n, u32 *rows, unsigned int y,
+		       unsigned int x)
+{
+	unsigned int half = 1U << (n->level - 1);
+
+	if (n->level == HL_LEAF_LEVEL) {
+		for (int r = 0; r < 8; ++r)
+			rows[y + r] |= (u32)((n->bits >> (8 * r)) & 0xff) << x;
+		return;
+	}
+
+	hl_to_rows(n->child[0], rows, y, x);
+	hl_to_rows(n->child[1], rows, y, x + half);
+	hl_to_rows(n->child[2], rows, y + half, x);
+	hl_to_rows(n->child[3], rows, y + half, x + half);
+}
+
+/*
+ * Runs 2^j generations of a base level node directly.  Cells outside the
+ * node count as dead, which corrupts one more ring of cells per generation,
+ * so the centre 16x16 is exact for up to 8 generations.  Kept out of line
+ * to keep its rows off the stack of the hl_step() recursion.
+ */
+static noinline_for_stack struct hl_node *hl_base(struct hl_node *n, unsigned int j)
+{
+	u32 rows[32] = { 0 }, next[32];
+	struct hl_node *quad[4];
+
+	hl_to_rows(n, rows, 0, 0);
+
+	for (unsigned int g = 0; g < (1U << j); ++g) {
+		for (int r = 0; r < 32; ++r) {
+			u32 up = r ? rows[r - 1] : 0;
+			u32 mid = rows[r];
+			u32 down = r < 31 ? rows[r + 1] : 0;
+
+			next[r] = gol_next_word(up << 1, up, up >> 1,
+						mid << 1, mid, mid >> 1,
+						down << 1, down, down >> 1,
+						GOL_CONWAY_BIRTH, GOL_CONWAY_SURVIVE);
+		}
+		memcpy(rows, next, sizeof(rows));
+	}
+
+	for (int i = 0; i < 4; ++i) {
+		unsigned int y = 8 + 8 * (i / 2), x = 8 + 8 * (i % 2);
+		u64 bits = 0;
 
-struct gol_info {
-	char live_cell;
-	char dead_cell;
-	int board[ROWS][COLUMNS];
-};
+		for (int r = 0; r < 8; ++r)
+			bits |= (u64)((rows[y + r] >> x) & 0xff) << (8 * r);
+		quad[i] = hl_leaf(bits);
+	}
+	return hl_join(quad[0], quad[1], quad[2], quad[3]);
+}
 
-struct thread_node {
-	pid_t thread_id;
-	struct list_head list;
-};
+/*
+ * The centre of @n, a node of at least the base level, 2^j generations later
+ * for j <= level - 2.  Returns NULL when the cache runs out of memory.
+ */
+static struct hl_node *hl_step(struct hl_node *n, unsigned int j)
+{
+	unsigned int full = n->level - 2;
+	struct hl_node *s[9], *res;
 
-// Define a linked list head and a mutex for synchronization
-LIST_HEAD(working_threads);
-struct mutex working_threads_mutex;
+	if (j == full && n->result)
+		return n->result;
+	if (j != full && n->step_result && n->step_j == j)
+		return n->step_result;
 
-/* Device file operations */
-int goldev_open(struct inode *inode, struct file *filep)
-{
-	pr_info("open called by thread %d\n", current->pid);
+	if (n->level == HL_BASE_LEVEL) {
+		res = hl_base(n, j);
+	} else {
+		struct hl_node *nw = n->child[0], *ne = n->child[1];
+		struct hl_node *sw = n->child[2], *se = n->child[3];
 
-	// Check if thread is on.
-	struct thread_node *pos;
-
-	mutex_lock(&working_threads_mutex);
-	list_for_each_entry(pos, &working_threads, list) {
-		if (current->pid == pos->thread_id) {
-			pr_info("Thread %d already opened the device\n", current->pid);
-			mutex_unlock(&working_threads_mutex);
-			return -EBUSY;
+		// The nine overlapping level - 1 sub-nodes, row by row.
+		s[0] = nw;
+		s[1] = hl_join(nw->child[1], ne->child[0], nw->child[3], ne->child[2]);
+		s[2] = ne;
+		s[3] = hl_join(nw->child[2], nw->child[3], sw->child[0], sw->child[1]);
+		s[4] = hl_centre(n);
+		s[5] = hl_join(ne->child[2], ne->child[3], se->child[0], se->child[1]);
+		s[6] = sw;
+		s[7] = hl_join(sw->child[1], se->child[0], sw->child[3], se->child[2]);
+		s[8] = se;
+
+		// A full step spends half of its generations on the sub-nodes
+		// and half on the four quadrants built from their results.
+		for (int i = 0; i < 9; ++i) {
+			if (!s[i])
+				return NULL;
+			s[i] = j == full ? hl_step(s[i], full - 1) : hl_centre(s[i]);
+			if (!s[i])
+				return NULL;
+		}
+
+		s[0] = hl_join(s[0], s[1], s[3], s[4]);
+		s[1] = hl_join(s[1], s[2], s[4], s[5]);
+		s[2] = hl_join(s[3], s[4], s[6], s[7]);
+		s[3] = hl_join(s[4], s[5], s[7], s[8]);
+		for (int i = 0; i < 4; ++i) {
+			if (!s[i])
+				return NULL;
+			s[i] = hl_step(s[i], min(j, full - 1));
 		}
+		res = hl_join(s[0], s[1], s[2], s[3]);
+		cond_resched();
 	}
-	mutex_unlock(&working_threads_mutex);
 
-	// Since the current thread isn't working add it to the list.
-	struct thread_node *new_node = kmalloc(sizeof(*new_node), GFP_KERNEL);
+	if (!res)
+		return NULL;
 
-	if (!new_node)
-		return -ENOMEM;
+	hl_get(res);
+	if (j == full) {
+		n->result = res;
+	} else {
+		if (n->step_result)
+			hl_put(n->step_result);
+		n->step_result = res;
+		n->step_j = j;
+	}
+	return res;
+}
 
-	new_node->thread_id = current->pid;
-	mutex_lock(&working_threads_mutex);
-	list_add(&new_node->list, &working_threads);
-	mutex_unlock(&working_threads_mutex);
+/* Leaf with its top-left corner at (@y, @x) of the periodic plane */
+static struct hl_node *hl_load_leaf(struct gol_info *data, unsigned int y,
+				    unsigned int x)
+{
+	unsigned int col = x % data->cols;
+	u64 bits = 0;
+
+	for (unsigned int r = 0; r < 8; ++r) {
+		const u32 *row = gol_row(data, (y + r) % data->rows);
+		u64 byte = 0;
+
+		if (data->cols >= 8) {
+			byte = (row[col / 32] >> (col % 32)) & 0xff;
+		} else {
+			for (unsigned int c = 0; c < 8; ++c)
+				byte |= (u64)row_cell(row, (x + c) % data->cols) << c;
+		}
+		bits |= byte << (8 * r);
+	}
+	return hl_leaf(bits);
+}
 
+/*
+ * Builds the node of @level at (@y, @x).  Once a half is as large as the
+ * board its neighbour half repeats it, so every cell is read only once.
+ */
+static struct hl_node *hl_load(struct gol_info *data, unsigned int level,
+			       unsigned int y, unsigned int x)
+{
+	unsigned int half = 1U << (level - 1);
+	struct hl_node *nw, *ne, *sw, *se;
 
-	struct gol_info *data = kmalloc(sizeof(struct gol_info), GFP_KERNEL);
+	if (level == HL_LEAF_LEVEL)
+		return hl_load_leaf(data, y, x);
 
-	if (!data) {
-		printk(KERN_ERR "Memory allocation failed\n");
-		return -ENOMEM;
+	nw = hl_load(data, level - 1, y, x);
+	ne = half >= data->cols ? nw : hl_load(data, level - 1, y, x + half);
+	if (half >= data->rows) {
+		sw = nw;
+		se = ne;
+	} else {
+		sw = hl_load(data, level - 1, y + half, x);
+		se = half >= data->cols ? sw : hl_load(data, level - 1, y + half, x + half);
 	}
+	return hl_join(nw, ne, sw, se);
+}
 
-	data->live_cell = '*';
-	data->dead_cell = ' ';
-	for (int i = 0; i < ROWS; ++i) {
-		for (int j = 0; j < COLUMNS; ++j)
-			data->board[i][j] = 0;
+/* Writes the part of @n at (@y, @x) that lies on the board into the back grid. */
+static void hl_store(struct gol_info *data, struct hl_node *n,
+		     unsigned int y, unsigned int x)
+{
+	unsigned int half = 1U << (n->level - 1);
+
+	if (y >= data->rows || x >= data->cols || !n->alive)
+		return;
+
+	if (n->level == HL_LEAF_LEVEL) {
+		for (unsigned int r = 0; r < 8 && y + r < data->rows; ++r) {
+			u32 byte = (n->bits >> (8 * r)) & 0xff;
+
+			if (data->cols < 8)
+				byte &= GENMASK(data->cols - 1, 0);
+			back_row(data, y + r)[x / 32] |= byte << (x % 32);
+		}
+		return;
 	}
 
-	filep->private_data = (void *)(data);
-	return 0;
+	hl_store(data, n->child[0], y, x);
+	hl_store(data, n->child[1], y, x + half);
+	hl_store(data, n->child[2], y + half, x);
+	hl_store(data, n->child[3], y + half, x + half);
 }
 
-int goldev_close(struct inode *inode, struct file *filep)
+/*
+ * Advances the tile of side 2^k by 2^j generations.  Above the tile the
+ * plane is built from four copies of the level below; stepping a node of
+ * at least level k + 2 returns a centre that starts on a multiple of the
+ * tile side, so its top-left level k node is the advanced tile.
+ */
+static struct hl_node *hl_advance(struct hl_node *tile, unsigned int k,
+				  unsigned int j)
 {
-	if (filep->private_data) {
-		pr_info("Device released by thread\n");
+	unsigned int level = max3(k + 2, j + 2, (unsigned int)HL_BASE_LEVEL);
+	struct hl_node *n = tile;
 
-		// Free the memory allocated for this thread's open
-		kfree(filep->private_data);
-		filep->private_data = NULL;
-	}
+	for (unsigned int l = k; l < level && n; ++l)
+		n = hl_join(n, n, n, n);
+	if (!n)
+		return NULL;
+
+	n = hl_step(n, j);
+	for (unsigned int l = level - 1; l > k && n; --l)
+		n = n->child[0];
+	return n;
+}
+
+/*
+ * Runs up to @generations generations with the Hashlife engine and returns
+ * how many were run, fewer when the cache cannot hold even a single
+ * generation's step or a fatal signal is pending.  Board dimensions must be
+ * powers of two.
+ */
+static u64 hashlife_run(struct gol_info *data, u64 generations)
+{
+	unsigned int k = ilog2(max3(data->rows, data->cols, 8U));
+	unsigned int max_j = HL_MAX_STEP;
+	struct hl_node *tile;
+	u64 done = 0;
+
+	mutex_lock(&hashlife.lock);
+	if (hl_init())
+		goto out_unlock;
+
+	hl_evict(hl_max_nodes());
+	tile = hl_load(data, k, 0, 0);
+	if (!tile)
+		goto out_unlock;
+	hl_get(tile);
 
-	struct thread_node *node, *tmp;
+	// Step by the lowest set bit of what is left, so every step is a
+	// power of two the tree can take in one go.
+	while (done < generations) {
+		unsigned int j = min_t(unsigned int, __ffs64(generations - done),
+				       max_j);
+		struct hl_node *next = hl_advance(tile, k, j);
 
-	mutex_lock(&working_threads_mutex);
-	list_for_each_entry_safe(node, tmp, &working_threads, list) {
-		if (node->thread_id == current->pid) {
-			// Remove the node from the list
-			list_del(&node->list);
-			// Free the memory allocated for the node
-			kfree(node);
-			break;  // Exit after deleting the first matching node
+		if (!next) {
+			// The step hit the cap, make room and halve it.
+			hl_evict(0);
+			if (!j)
+				break;
+			max_j = j - 1;
+			continue;
 		}
+
+		hl_get(next);
+		hl_put(tile);
+		tile = next;
+		done += BIT_ULL(j);
+
+		hl_evict(hl_max_nodes());
+		if (fatal_signal_pending(current))
+			break;
+		cond_resched();
 	}
-	mutex_unlock(&working_threads_mutex);
-	return 0;
+
+	if (done) {
+		memset(data->back, 0,
+		       (size_t)data->rows * data->words * sizeof(u32));
+		hl_store(data, tile, 0, 0);
+		back_changed(data, 0, data->rows);
+		swap(data->board, data->back);
+		tiles_reset(data);
+	}
+	hl_put(tile);
+	hl_evict(hl_max_nodes());
+out_unlock:
+	mutex_unlock(&hashlife.lock);
+	return done;
 }
 
-ssize_t goldev_read(struct file *filep, char *__user buf, size_t count,
-		    loff_t *fpos)
+/* Keeps the board as the current generation before it is advanced. */
+static void history_record(struct gol_info *data)
+{
+	struct gol_history *history = &data->history;
+	size_t size = board_size(data->rows, data->words);
+	unsigned int slot;
+
+	if (!history->depth)
+		return;
+
+	div_u64_rem(data->generation, history->depth, &slot);
+	memcpy((void *)history->boards + slot * size, data->board, size);
+	history->gen[slot] = data->generation;
+}
+
+/* The board at @generation, NULL if it was not retained. */
+static const u32 *history_board(struct gol_info *data, u64 generation)
+{
+	struct gol_history *history = &data->history;
+	unsigned int slot;
+
+	if (generation == data->generation)
+		return data->board;
+	if (!history->depth || generation > data->generation)
+		return NULL;
+
+	div_u64_rem(generation, history->depth, &slot);
+	if (history->gen[slot] != generation)
+		return NULL;
+	return (void *)history->boards +
+	       slot * board_size(data->rows, data->words);
+}
+
+/* Hash of tile @t, seeded with its index so equal tiles do not cancel out. */
+static u64 tile_hash(struct gol_info *data, size_t t)
+{
+	unsigned int first = t / data->words * GOL_TILE_ROWS;
+	unsigned int k = t % data->words;
+	u32 words[GOL_TILE_ROWS] = { 0 };
+
+	for (unsigned int i = first; i < min(first + GOL_TILE_ROWS, data->rows); ++i)
+		words[i - first] = gol_row(data, i)[k];
+	return xxh64(words, sizeof(words), t);
+}
+
+/*
+ * Brings cycle->board_hash to the current board, rehashing every tile or
+ * only the ones the last generation changed.
+ */
+static void board_hash_update(struct gol_info *data, bool all)
 {
-	struct gol_info *data = (struct gol_info *)filep->private_data;
-	int idx = 0;
-	char _buf[HEIGHT * WIDTH + 1];
+	struct gol_cycle *cycle = &data->cycle;
 
-	for (int j = 0; j < (WIDTH - 1); ++j)
-		_buf[idx++] = '-';
-	_buf[idx++] = '\n';
+	if (all)
+		cycle->board_hash = 0;
+	for (size_t t = 0; t < nr_tiles(data); ++t) {
+		u64 hash;
 
-	for (int i = 0; i < ROWS; ++i) {
-		_buf[idx++] = '|';
-		for (int j = 0; j < COLUMNS; ++j)
-			_buf[idx++] = data->board[i][j] ? data->live_cell : data->dead_cell;
-		_buf[idx++] = '|';
-		_buf[idx++] = '\n';
+		if (!all && !data->tile_changed[t])
+			continue;
+		hash = tile_hash(data, t);
+		cycle->board_hash ^= (all ? 0 : cycle->tile_hash[t]) ^ hash;
+		cycle->tile_hash[t] = hash;
 	}
+}
 
-	for (int j = 0; j < (WIDTH - 1); ++j)
-		_buf[idx++] = '-';
-	_buf[idx++] = '\n';
-	_buf[idx++] = '\0';
+/* The board at @generation if it is still held anywhere, or NULL. */
+static const u32 *cycle_board(struct gol_info *data, u64 generation)
+{
+	if (data->cycle.checked == generation)
+		return data->cycle.board;
+	return history_board(data, generation);
+}
 
-	size_t bytes_not_written = copy_to_user(buf, _buf, idx);
+/* Makes @period, found from generation @start, the board's cycle. */
+static bool cycle_confirm(struct gol_info *data, const u32 *board, u64 period,
+			  u64 start)
+{
+	if (memcmp(board, data->board, board_size(data->rows, data->words)))
+		return false;
+	data->cycle.period = period;
+	data->cycle.start = start;
+	return true;
+}
 
-	if (bytes_not_written)
-		return -EFAULT;
+/* Counts the cells the last swap brought to life and the ones it killed. */
+static void count_changes(struct gol_info *data, u64 *born, u64 *died)
+{
+	size_t words = (size_t)data->rows * data->words;
 
-	return idx;
+	*born = 0;
+	*died = 0;
+	for (size_t k = 0; k < words; ++k) {
+		*born += hweight32(data->board[k] & ~data->back[k]);
+		*died += hweight32(data->back[k] & ~data->board[k]);
+	}
 }
 
-ssize_t goldev_write(struct file *filep, const char *__user buf, size_t count,
-		     loff_t *fpos)
+/* Accounts for a tick of @count generations that started at @start. */
+static void tick_done(struct gol_info *data, u64 start, u64 count)
 {
-	pr_info("write called with %llu\n", *fpos);
-	struct gol_info *data = (struct gol_info *)filep->private_data;
+	u64 duration = ktime_get_ns() - start;
+	u64 born, died;
 
-	if ((*fpos) < 0 || 511 < (*fpos))
-		return -EPERM;
+	data->counters.generations += count;
+	data->counters.tick_ns[min(fls64(duration), GOL_LATENCY_BUCKETS - 1)]++;
 
-	int row = (*fpos) / COLUMNS;
-	int col = (*fpos) % COLUMNS;
+	if (trace_gol_tick_end_enabled()) {
+		count_changes(data, &born, &died);
+		trace_gol_tick_end(data->owner, data->generation, duration,
+				   born, died);
+	}
+}
 
-	data->board[row][col] = 1 - data->board[row][col];
-	(*fpos) += 1;
-	return 0;
+/* Runs one generation with the dense engines. */
+static void advance_board(struct gol_info *data)
+{
+	u64 start = ktime_get_ns();
+
+	trace_gol_tick_start(data->owner, data->generation, 1);
+	update_board(data);
+	data->generation++;
+	tick_done(data, start, 1);
 }
 
-static loff_t goldev_llseek(struct file *filep, loff_t off, int whence)
+/* Advances the board by one generation while looking for a cycle. */
+static void gol_tick(struct gol_info *data)
 {
-	pr_info("lseek called with %llu\n", off);
-	loff_t retval;
+	struct gol_cycle *cycle = &data->cycle;
+	u64 hash;
 
-	switch (whence) {
-	case SEEK_SET:
-		retval = off;
-		break;
-	case SEEK_CUR:
-		retval = filep->f_pos + off;
-		break;
-	case SEEK_END:
-		retval = 511 + off;
-		break;
-	default:
-		return -EINVAL;
+	history_record(data);
+
+	if (cycle->period) {
+		advance_board(data);
+		gol_publish(data);
+		return;
 	}
 
-	if (retval > 511)
-		return -EPERM;
+	// The first generation is kept, oscillators usually repeat it.
+	if (!cycle->depth) {
+		board_hash_update(data, true);
+		cycle->hash[data->generation % GOL_CYCLE_RING] = cycle->board_hash;
+		cycle->depth = 1;
+		memcpy(cycle->board, data->board,
+		       board_size(data->rows, data->words));
+		cycle->checked = data->generation;
+		cycle->candidate = 0;
+	}
 
-	return (filep->f_pos = retval);
+	advance_board(data);
+	gol_publish(data);
+	board_hash_update(data, false);
+	hash = cycle->board_hash;
+
+	if (cycle->candidate &&
+	    data->generation - cycle->checked == cycle->candidate) {
+		if (cycle_confirm(data, cycle->board, cycle->candidate,
+				  cycle->checked))
+			return;
+		// The hashes collided.
+		cycle->candidate = 0;
+		cycle->checked = U64_MAX;
+	}
+
+	// The smallest matching distance is the period, older slots are
+	// compared before this generation overwrites the oldest one.
+	for (u64 p = 1; !cycle->candidate && p <= cycle->depth; ++p) {
+		const u32 *board;
+
+		if (cycle->hash[(data->generation - p) % GOL_CYCLE_RING] != hash)
+			continue;
+
+		board = cycle_board(data, data->generation - p);
+		if (!board) {
+			memcpy(cycle->board, data->board,
+			       board_size(data->rows, data->words));
+			cycle->checked = data->generation;
+			cycle->candidate = p;
+		} else if (cycle_confirm(data, board, p, data->generation - p)) {
+			return;
+		}
+	}
+
+	cycle->hash[data->generation % GOL_CYCLE_RING] = hash;
+	if (cycle->depth < GOL_CYCLE_RING)
+		cycle->depth++;
 }
 
-static int count_neighbors(struct gol_info *data, int row, int col)
+/*
+ * Runs up to @n generations with the Hashlife engine when it is selected, @n
+ * is at least HL_MIN_GENERATIONS, the board is a power of two in both
+ * dimensions and follows B3/S23, the rule the shared cache was built with.
+ * Returns how many ran, 0 means the caller has to fall back to the dense
+ * engines.
+ */
+static u64 tick_hashlife(struct gol_info *data, u64 n)
 {
-	int ret = 0;
+	u64 start, done;
 
-	for (int i = row - 1; i <= row + 1; ++i) {
-		int ii = (i < 0 ? ROWS + i : i) % ROWS;
+	if (READ_ONCE(engine) != GOL_ENGINE_HASHLIFE ||
+	    n < HL_MIN_GENERATIONS ||
+	    !is_power_of_2(data->rows) || !is_power_of_2(data->cols) ||
+	    data->rule.birth != GOL_CONWAY_BIRTH ||
+	    data->rule.survive != GOL_CONWAY_SURVIVE)
+		return 0;
 
-		for (int j = col - 1; j <= col + 1; ++j) {
-			int jj = (j < 0 ? COLUMNS + j : j) % COLUMNS;
+	history_record(data);
+	start = ktime_get_ns();
+	trace_gol_tick_start(data->owner, data->generation, n);
+	done = hashlife_run(data, n);
+	if (!done)
+		return 0;
 
-			if (i == row && j == col)
-				continue;
+	data->generation += done;
+	tick_done(data, start, done);
+	gol_publish(data);
+	// The skipped generations never went through the ring.
+	data->cycle.depth = 0;
+	return done;
+}
+
+/* Generations computed between checks for fatal signals and rescheduling */
+#define GOL_TICK_BATCH (1024)
+
+static long tick_generations(struct gol_info *data, u64 __user *argp)
+{
+	u64 requested, done = 0;
+	long ret = 0;
+
+	if (get_user(requested, argp))
+		return -EFAULT;
+
+	while (done < requested) {
+		u64 period = data->cycle.period;
+		u64 batch;
 
-			if (data->board[ii][jj])
-				++ret;
+		// Whole periods leave the board unchanged, skip over them.
+		if (period) {
+			u64 skip, rem;
+
+			skip = div64_u64_rem(requested - done, period, &rem) * period;
+			data->generation += skip;
+			done += skip;
+			gol_publish(data);
+		}
+
+		batch = done < requested ? tick_hashlife(data, requested - done) : 0;
+		if (!batch) {
+			batch = min_t(u64, requested - done, GOL_TICK_BATCH);
+			for (u64 i = 0; i < batch; ++i)
+				gol_tick(data);
+		}
+		done += batch;
+		gol_notify(data);
+
+		if (fatal_signal_pending(current)) {
+			ret = -EINTR;
+			break;
 		}
+
+		// Let readers in between batches.
+		mutex_unlock(&data->lock);
+		cond_resched();
+		mutex_lock(&data->lock);
 	}
+
+	if (put_user(done, argp))
+		return -EFAULT;
 	return ret;
 }
 
-int new_board[ROWS][COLUMNS];
-static void update_board(struct gol_info *data)
+static long get_cycle(struct gol_info *data,
+		      struct gol_cycle_info __user *argp)
 {
-	for (int i = 0; i < ROWS; ++i) {
-		for (int j = 0; j < COLUMNS; ++j) {
-			int neighbors = count_neighbors(data, i, j);
-
-			if (data->board[i][j]) {
-				// Live Cell
-				if (neighbors < 2) {
-					// Under-population
-					new_board[i][j] = 0;
-				} else if (neighbors > 3) {
-					// Over-population
-					new_board[i][j] = 0;
-				} else {
-					new_board[i][j] = 1;
-				}
-			} else {
-				// Dead Cell
-				if (neighbors == 3) {
-					// Reproduction
-					new_board[i][j] = 1;
-				} else {
-					new_board[i][j] = 0;
-				}
-			}
-		}
+	struct gol_cycle_info info = {
+		.generation = data->generation,
+		.period = data->cycle.period,
+		.start = data->cycle.start,
+	};
+
+	if (copy_to_user(argp, &info, sizeof(info)))
+		return -EFAULT;
+	return 0;
+}
+
+static long set_geometry(struct gol_info *data,
+			 struct gol_geometry __user *argp)
+{
+	struct gol_geometry geometry;
+	int ret;
+
+	if (copy_from_user(&geometry, argp, sizeof(geometry)))
+		return -EFAULT;
+
+	if (geometry.rows < 1 || GOL_MAX_ROWS < geometry.rows ||
+	    geometry.columns < 1 || GOL_MAX_COLUMNS < geometry.columns)
+		return -EINVAL;
+
+	// Mappings would keep pointing at the old buffers.
+	mutex_lock(&data->map_lock);
+	if (atomic_read(&data->mapped))
+		ret = -EBUSY;
+	else
+		ret = gol_resize(data, geometry.rows, geometry.columns);
+	mutex_unlock(&data->map_lock);
+	return ret;
+}
+
+/*
+ * Timer-driven runs
+ *
+ * The hrtimer fires once per period and queues run_work, which ticks the
+ * board under its lock.  A period is dropped, and counted as an overrun,
+ * when the timer fires late enough to skip it or when the previous tick has
+ * not run yet.  Lateness is measured from the expiry to the end of the tick.
+ */
+static enum hrtimer_restart run_timer_fn(struct hrtimer *timer)
+{
+	struct gol_info *data = container_of(timer, struct gol_info, run_timer);
+	ktime_t due = hrtimer_get_expires(timer);
+	u64 periods = hrtimer_forward_now(timer, data->run_period);
+
+	if (periods > 1)
+		atomic64_add(periods - 1, &data->run_overruns);
+
+	// The timer is the only one queueing run_work, it cannot become
+	// pending between the check and queue_work().
+	if (work_pending(&data->run_work)) {
+		atomic64_inc(&data->run_overruns);
+	} else {
+		WRITE_ONCE(data->run_due, due);
+		queue_work(gol_wq, &data->run_work);
 	}
+	return HRTIMER_RESTART;
+}
+
+static void run_work_fn(struct work_struct *work)
+{
+	struct gol_info *data = container_of(work, struct gol_info, run_work);
+
+	mutex_lock(&data->lock);
+	if (data->running) {
+		u64 late;
 
-	for (int i = 0; i < ROWS; ++i) {
-		for (int j = 0; j < COLUMNS; ++j)
-			data->board[i][j] = new_board[i][j];
+		gol_tick(data);
+
+		late = ktime_to_ns(ktime_sub(ktime_get(), READ_ONCE(data->run_due)));
+		data->run_generations++;
+		data->run_late_ns += late;
+		data->run_late_max_ns = max(data->run_late_max_ns, late);
 	}
+	mutex_unlock(&data->lock);
+
+	gol_notify(data);
 }
 
-static long goldev_ioctl(struct file *filep, unsigned int cmd,
-						 unsigned long arg)
+/* Called with the lock held, a queued run_work sees running cleared. */
+static void run_pause(struct gol_info *data)
+{
+	data->running = false;
+	hrtimer_cancel(&data->run_timer);
+}
+
+static long run_start(struct gol_info *data, unsigned long rate)
+{
+	if (rate < 1 || GOL_MAX_RATE < rate)
+		return -EINVAL;
+
+	run_pause(data);
+	data->run_rate = rate;
+	data->run_period = ns_to_ktime(NSEC_PER_SEC / rate);
+	data->run_generations = 0;
+	atomic64_set(&data->run_overruns, 0);
+	data->run_late_ns = 0;
+	data->run_late_max_ns = 0;
+	data->running = true;
+	hrtimer_start(&data->run_timer, data->run_period, HRTIMER_MODE_REL);
+	return 0;
+}
+
+/* Stops the run for good, before the board goes away. */
+static void run_stop(struct gol_info *data)
+{
+	mutex_lock(&data->lock);
+	run_pause(data);
+	mutex_unlock(&data->lock);
+	cancel_work_sync(&data->run_work);
+}
+
+static long get_run_stats(struct gol_info *data,
+			  struct gol_run_stats __user *argp)
+{
+	struct gol_run_stats stats = {
+		.rate = data->running ? data->run_rate : 0,
+		.generations = data->run_generations,
+		.overruns = atomic64_read(&data->run_overruns),
+		.late_max_ns = data->run_late_max_ns,
+	};
+
+	if (data->run_generations)
+		stats.late_avg_ns = div64_u64(data->run_late_ns, data->run_generations);
+
+	if (copy_to_user(argp, &stats, sizeof(stats)))
+		return -EFAULT;
+	return 0;
+}
+
+static long set_rule(struct gol_info *data, struct gol_rule __user *argp)
+{
+	struct gol_rule rule;
+	u16 birth, survive;
+
+	if (copy_from_user(&rule, argp, sizeof(rule)))
+		return -EFAULT;
+
+	if (strnlen(rule.rule, sizeof(rule.rule)) == sizeof(rule.rule) ||
+	    rule_parse(rule.rule, &birth, &survive))
+		return -EINVAL;
+
+	rule_compile(&data->rule, birth, survive);
+	// The remembered generations and changed tiles followed the old rule.
+	cycle_reset(data);
+	tiles_reset(data);
+	// Changes what read(2) returns.
+	WRITE_ONCE(data->frame, data->frame + 1);
+	return 0;
+}
+
+static long set_history(struct gol_info *data, unsigned long depth)
+{
+	size_t size = board_size(data->rows, data->words);
+	struct gol_history history;
+
+	if (depth > history_max_depth(size))
+		return -EINVAL;
+	if (history_alloc(&history, depth, size))
+		return -ENOMEM;
+
+	history_free(&data->history);
+	data->history = history;
+	return 0;
+}
+
+/*
+ * Brings back the board @k generations ago.  The generations after it are
+ * dropped, ticking again records the new ones.
+ */
+static long rewind_generations(struct gol_info *data, unsigned long k)
 {
-	pr_info("ioctl called\n");
-	struct gol_info *data = (struct gol_info *)filep->private_data;
+	struct gol_history *history = &data->history;
+	const u32 *board;
+	u64 target, first;
 
+	if (!k)
+		return 0;
+	if (k > data->generation)
+		return -ENOENT;
+
+	target = data->generation - k;
+	board = history_board(data, target);
+	if (!board)
+		return -ENOENT;
+
+	memcpy(data->back, board, board_size(data->rows, data->words));
+	back_changed(data, 0, data->rows);
+	swap(data->board, data->back);
+
+	// Only the last depth generations can still hold a slot.
+	first = k > history->depth ? data->generation - history->depth : target + 1;
+	for (u64 g = first; g < data->generation; ++g) {
+		unsigned int slot;
+
+		div_u64_rem(g, history->depth, &slot);
+		if (history->gen[slot] == g)
+			history->gen[slot] = U64_MAX;
+	}
+
+	data->generation = target;
+	tiles_reset(data);
+	cycle_reset(data);
+	gol_publish(data);
+	return 0;
+}
+
+/* Copies a retained generation out as a bitmap. */
+static long get_generation(struct gol_info *data,
+			   struct gol_generation __user *argp)
+{
+	struct gol_generation generation;
+	struct render_ctx ctx = { .page = data->render, .limit = SIZE_MAX };
+	const u32 *board;
+
+	if (copy_from_user(&generation, argp, sizeof(generation)))
+		return -EFAULT;
+
+	board = history_board(data, generation.generation);
+	if (!board)
+		return -ENOENT;
+
+	ctx.dst = u64_to_user_ptr(generation.bitmap);
+	render_bitmap(data, board, &ctx);
+	render_flush(&ctx);
+	return ctx.err;
+}
+
+static long get_tile_stats(struct gol_info *data,
+			   struct gol_tile_stats __user *argp)
+{
+	struct gol_tile_stats stats = {
+		.tiles = nr_tiles(data),
+		.last = data->tiles_last,
+		.generations = data->tile_generations,
+		.evaluated = data->tiles_evaluated,
+	};
+
+	if (copy_to_user(argp, &stats, sizeof(stats)))
+		return -EFAULT;
+	return 0;
+}
+
+/* Commands that change the board, only its owner may issue them. */
+static long board_ioctl(struct gol_info *data, unsigned int cmd,
+			unsigned long arg)
+{
 	switch (cmd) {
 	case GOL_TICK:
-		update_board(data);
+		gol_tick(data);
 		break;
+	case GOL_TICK_N:
+		return tick_generations(data, (u64 __user *)arg);
+	case GOL_GEOMETRY:
+		return set_geometry(data, (struct gol_geometry __user *)arg);
 	case GOL_LIVE:
 		if (arg < 0x21 || 0x7e < arg)
 			return -EINVAL;
 		data->live_cell = (char)arg;
+		// Changes what read(2) returns.
+		WRITE_ONCE(data->frame, data->frame + 1);
+		break;
+	case GOL_RUN:
+		return run_start(data, arg);
+	case GOL_PAUSE:
+		run_pause(data);
 		break;
+	case GOL_STEP:
+		run_pause(data);
+		gol_tick(data);
+		break;
+	case GOL_RULE:
+		return set_rule(data, (struct gol_rule __user *)arg);
+	case GOL_HISTORY:
+		return set_history(data, arg);
+	case GOL_REWIND:
+		return rewind_generations(data, arg);
 	default:
 		return -EPERM;
 	}
 	return 0;
 }
 
+static long goldev_ioctl(struct file *filep, unsigned int cmd,
+						 unsigned long arg)
+{
+	struct gol_file *gf = (struct gol_file *)filep->private_data;
+	struct gol_info *data = gf->data;
+	long ret;
+
+	trace_gol_ioctl(data->owner, cmd, arg);
+
+	switch (cmd) {
+	case GOL_FORMAT:
+		if (arg != GOL_FORMAT_TEXT && arg != GOL_FORMAT_BITMAP &&
+		    arg != GOL_FORMAT_RLE && arg != GOL_FORMAT_DIFF)
+			return -EINVAL;
+		gf->format = arg;
+		return 0;
+	case GOL_LOAD:
+		if (arg != GOL_LOAD_TOGGLE && arg != GOL_LOAD_BITMAP &&
+		    arg != GOL_LOAD_RLE && arg != GOL_LOAD_LIFE106)
+			return -EINVAL;
+		gf->load = arg;
+		return 0;
+	case GOL_WAIT:
+		gf->wait = arg;
+		return 0;
+	case GOL_OBSERVE:
+		return gol_observe((pid_t)arg);
+	case GOL_CYCLE:
+		mutex_lock(&data->lock);
+		ret = get_cycle(data, (struct gol_cycle_info __user *)arg);
+		mutex_unlock(&data->lock);
+		return ret;
+	case GOL_RUN_STATS:
+		mutex_lock(&data->lock);
+		ret = get_run_stats(data, (struct gol_run_stats __user *)arg);
+		mutex_unlock(&data->lock);
+		return ret;
+	case GOL_TILE_STATS:
+		mutex_lock(&data->lock);
+		ret = get_tile_stats(data, (struct gol_tile_stats __user *)arg);
+		mutex_unlock(&data->lock);
+		return ret;
+	case GOL_GENERATION:
+		mutex_lock(&data->lock);
+		ret = get_generation(data, (struct gol_generation __user *)arg);
+		mutex_unlock(&data->lock);
+		return ret;
+	}
+
+	if (gf->observer)
+		return -EPERM;
+
+	mutex_lock(&data->lock);
+	ret = board_ioctl(data, cmd, arg);
+	mutex_unlock(&data->lock);
+
+	gol_notify(data);
+	return ret;
+}
+
+static void goldev_vm_open(struct vm_area_struct *vma)
+{
+	struct gol_info *data = vma->vm_private_data;
+
+	atomic_inc(&data->mapped);
+}
+
+static void goldev_vm_close(struct vm_area_struct *vma)
+{
+	struct gol_info *data = vma->vm_private_data;
+
+	atomic_dec(&data->mapped);
+}
+
+static const struct vm_operations_struct goldev_vm_ops = {
+	.open = goldev_vm_open,
+	.close = goldev_vm_close,
+};
+
+/* Maps the header page and both buffers read-only. */
+static int goldev_mmap(struct file *filep, struct vm_area_struct *vma)
+{
+	struct gol_file *gf = (struct gol_file *)filep->private_data;
+	struct gol_info *data = gf->data;
+	int ret;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EACCES;
+	vm_flags_clear(vma, VM_MAYWRITE);
+
+	// Not data->lock: read(2) takes the mmap lock under it when it faults
+	// on the user buffer, and mmap(2) runs under the mmap lock.
+	mutex_lock(&data->map_lock);
+	ret = remap_vmalloc_range(vma, data->shared, vma->vm_pgoff);
+	if (!ret) {
+		vma->vm_ops = &goldev_vm_ops;
+		vma->vm_private_data = data;
+		goldev_vm_open(vma);
+	}
+	mutex_unlock(&data->map_lock);
+	return ret;
+}
+
 struct file_operations goldev_fops = {
 	.owner = THIS_MODULE,
 	.open = goldev_open,
 	.read = goldev_read,
 	.write = goldev_write,
 	.llseek = goldev_llseek,
+	.poll = goldev_poll,
+	.mmap = goldev_mmap,
 	.release = goldev_close,
 	.unlocked_ioctl = goldev_ioctl,
 };
@@ -291,8 +2713,21 @@ int __init goldev_init(void)
 {
 	pr_info("init\n");
 
-	// Initialize the mutex
-	mutex_init(&working_threads_mutex);
+	mutex_init(&hashlife.lock);
+
+	gol_wq = alloc_workqueue("game_of_life", WQ_UNBOUND | WQ_HIGHPRI, 0);
+	if (!gol_wq)
+		return -ENOMEM;
+
+	gol_band_wq = alloc_workqueue("game_of_life_bands",
+				      WQ_UNBOUND | WQ_HIGHPRI, 0);
+	if (!gol_band_wq) {
+		destroy_workqueue(gol_wq);
+		return -ENOMEM;
+	}
+
+	// Still works without debugfs, the calls on its entries do nothing.
+	gol_debugfs = debugfs_create_dir(DEVNAME, NULL);
 
 	int ret = alloc_chrdev_region(&goldev.devnum, 0, 1, DEVNAME);
 
@@ -334,6 +2769,9 @@ err_cdev_add:
 err_class_create:
 	unregister_chrdev_region(goldev.devnum, 1);
 err_alloc_chrdev_region:
+	debugfs_remove(gol_debugfs);
+	destroy_workqueue(gol_band_wq);
+	destroy_workqueue(gol_wq);
 	return ret;
 }
 
@@ -345,6 +2783,10 @@ void goldev_cleanup(void)
 	cdev_del(&goldev.cdev);
 	class_destroy(goldev.class);
 	unregister_chrdev_region(goldev.devnum, 10);
+	debugfs_remove(gol_debugfs);
+	destroy_workqueue(gol_wq);
+	destroy_workqueue(gol_band_wq);
+	hl_destroy();
 }
 
 module_init(goldev_init);
@@ -5,27 +5,216 @@
  *  <----! Game of Life written in C ---->
  *
  *	  open(2) - creates new grid
- *	  read(2) - reads whole grid
- *	  write(2) - toggles cell specified by the seek pointer
+ *	  read(2) - reads whole grid in the selected format, count must be at
+ *				least the size of the output (or 0 for the text frame)
+ *	  poll(2) - readable once there is a frame this file has not read
+ *	  write(2) - toggles cell specified by the seek pointer, or replaces the
+ *				 whole grid with the written pattern (see GOL_LOAD)
  *	  lseek(2) - sets the seek point to the given cell
+ *	  mmap(2) - maps the grid read-only (struct gol_shared)
  *	  ioctl(2) - op 0 replaces * with another printable character
  *				 op 1 calculates the next generation
+ *				 op 3 calculates the next N generations, N is read from
+ *				 and the number of executed generations written back to
+ *				 the u64 the argument points to
+ *				 op 4 reports the detected period (struct gol_cycle_info)
+ *				 op 5 replaces the grid with an empty one of the given
+ *				 size (struct gol_geometry)
+ *				 op 6 selects the read(2) format (GOL_FORMAT_*)
+ *				 op 7 selects the write(2) format (GOL_LOAD_*)
+ *				 op 8 returns a new read-only file descriptor on the
+ *				 grid opened by the thread with the given id
+ *				 op 9 makes read(2) wait for a new frame (1) or not (0)
+ *				 op 10 ticks the grid from a kernel timer at the given
+ *				 number of generations per second
+ *				 op 11 stops the timer
+ *				 op 12 stops the timer and calculates one generation
+ *				 op 13 reports how the timer keeps up (struct
+ *				 gol_run_stats)
+ *				 op 14 reports how much of the grid the last
+ *				 generations evaluated (struct gol_tile_stats)
+ *				 op 15 replaces the B3/S23 rule (struct gol_rule)
+ *				 op 16 keeps the given number of past generations
+ *				 op 17 brings back the grid the given number of
+ *				 generations ago
+ *				 op 18 copies a past generation out (struct
+ *				 gol_generation)
  *	  close(2) - resets grid
  */
 
 #ifdef __KERNEL__
 #include <linux/ioctl.h>
+#include <linux/types.h>
 #else /* userspace */
 #include <sys/ioctl.h>
+#include <linux/types.h>
 #endif
 
 #define GOL_MAGIC ('g')
 #define GOL_TICK _IO(GOL_MAGIC, 0x01)
 #define GOL_LIVE _IOW(GOL_MAGIC, 0x02, char)
+#define GOL_TICK_N _IOWR(GOL_MAGIC, 0x03, __u64)
+#define GOL_CYCLE _IOR(GOL_MAGIC, 0x04, struct gol_cycle_info)
+#define GOL_GEOMETRY _IOW(GOL_MAGIC, 0x05, struct gol_geometry)
+#define GOL_FORMAT _IOW(GOL_MAGIC, 0x06, int)
 
+/*
+ * read(2) formats.  The text frame is the default.  The bitmap holds
+ * GOL_BITMAP_SIZE() bytes, row after row, with (cols + 7) / 8 bytes per row
+ * and column j in bit j % 8 of byte j / 8.  RLE is the usual Life pattern
+ * file: a "x = cols, y = rows, rule = B3/S23" line with the grid's rule,
+ * then runs of b (dead) and o (live) cells with $ ending a row and ! ending
+ * the pattern.  The diff
+ * holds only the rows that changed since the file's last read(2), the first
+ * read holding them all: one GOL_DIFF_RECORD_SIZE() record per row, its
+ * index then its (cols + 31) / 32 words laid out like the mmap(2) buffers,
+ * all little-endian.  count must be at least GOL_DIFF_SIZE().  Without
+ * GOL_WAIT the read returns 0 bytes when no row changed; with it, frames
+ * that change no row are not waited for.
+ */
+#define GOL_FORMAT_TEXT (0)
+#define GOL_FORMAT_BITMAP (1)
+#define GOL_FORMAT_RLE (2)
+#define GOL_FORMAT_DIFF (3)
+
+#define GOL_LOAD _IOW(GOL_MAGIC, 0x07, int)
+
+/*
+ * write(2) formats.  Toggling the cell at the seek pointer is the default.
+ * The others take a whole pattern in a single write and replace the grid
+ * with it, or leave it untouched if the pattern is invalid.  The bitmap is
+ * laid out like GOL_FORMAT_BITMAP and must be exactly GOL_BITMAP_SIZE()
+ * bytes.  An RLE pattern is placed at the top left corner and must fit the
+ * grid.  Life 1.06 cells ("#Life 1.06" then one "x y" pair per line) wrap
+ * around the grid, so negative coordinates count from the far edge.
+ */
+#define GOL_LOAD_TOGGLE (0)
+#define GOL_LOAD_BITMAP (1)
+#define GOL_LOAD_RLE (2)
+#define GOL_LOAD_LIFE106 (3)
+
+/*
+ * Every change to a grid, a generation or an edit, is a new frame.  A file
+ * from GOL_OBSERVE reads, polls and maps the grid but cannot change it.  With
+ * GOL_WAIT set, read(2) blocks until there is a frame newer than the one the
+ * file last read, for GOL_FORMAT_DIFF one that changed a row (EAGAIN with
+ * O_NONBLOCK), and returns 0 only once the grid's own file is closed and no
+ * new frame will come; poll(2) then reports POLLHUP.
+ */
+#define GOL_OBSERVE _IOW(GOL_MAGIC, 0x08, int)
+#define GOL_WAIT _IOW(GOL_MAGIC, 0x09, int)
+
+#define GOL_RUN _IOW(GOL_MAGIC, 0x0a, int)
+#define GOL_PAUSE _IO(GOL_MAGIC, 0x0b)
+#define GOL_STEP _IO(GOL_MAGIC, 0x0c)
+#define GOL_RUN_STATS _IOR(GOL_MAGIC, 0x0d, struct gol_run_stats)
+
+#define GOL_MAX_RATE (100000)
+
+/*
+ * Counted since the last GOL_RUN.  A generation that could not start on
+ * time because the previous one was still running is dropped and counted
+ * as an overrun.  Lateness is how long after its timer expired each
+ * generation was ready.
+ */
+struct gol_run_stats {
+	__u32 rate;		/* generations per second, 0 while stopped */
+	__u32 reserved;
+	__u64 generations;
+	__u64 overruns;
+	__u64 late_avg_ns;
+	__u64 late_max_ns;
+};
+
+#define GOL_TILE_STATS _IOR(GOL_MAGIC, 0x0e, struct gol_tile_stats)
+
+/*
+ * The grid is split into tiles of 8 rows by 32 columns.  A generation only
+ * evaluates the tiles next to one that changed in the generation before,
+ * the others cannot change, and the scalar engine evaluates them all.
+ * Counted since open(2) or the last GOL_GEOMETRY, generations run by the
+ * Hashlife engine are not.
+ */
+struct gol_tile_stats {
+	__u32 tiles;		/* in the whole grid */
+	__u32 last;		/* evaluated by the last generation */
+	__u64 generations;
+	__u64 evaluated;	/* over all generations */
+};
+
+#define GOL_RULE _IOW(GOL_MAGIC, 0x0f, struct gol_rule)
+
+/*
+ * A Life-like rule in B/S notation, "B36/S23" for HighLife: a dead cell is
+ * born with any of the neighbor counts after the B, a live one survives
+ * with any of those after the S.  A new rule forgets the detected period.
+ * The Hashlife engine only runs B3/S23, other rules use the dense engines.
+ */
+struct gol_rule {
+	char rule[32];		/* NUL-terminated */
+};
+
+#define GOL_HISTORY _IOW(GOL_MAGIC, 0x10, int)
+#define GOL_REWIND _IOW(GOL_MAGIC, 0x11, int)
+#define GOL_GENERATION _IOW(GOL_MAGIC, 0x12, struct gol_generation)
+
+/*
+ * GOL_HISTORY keeps the grid of the last N generations as they were when
+ * they were ticked, up to the history_max_mb module parameter (16 MiB by
+ * default), and forgets the ones kept so far.  Generations skipped over by
+ * period detection or the Hashlife engine are not kept.  GOL_REWIND fails
+ * with ENOENT when the generation was not kept, and drops the generations
+ * after the one it brings back.  GOL_GENERATION copies the current or a kept
+ * generation out in the GOL_FORMAT_BITMAP layout, GOL_BITMAP_SIZE() bytes.
+ */
+struct gol_generation {
+	__u64 generation;
+	__u64 bitmap;		/* user pointer */
+};
+
+/*
+ * Generations are counted from open(2).  A period of 0 means no cycle was
+ * found since the board was last modified; otherwise the board at generation
+ * start + k is the same as at start + k + period.
+ */
+struct gol_cycle_info {
+	__u64 generation;
+	__u64 period;
+	__u64 start;
+};
+
+struct gol_geometry {
+	__u32 rows;
+	__u32 columns;
+};
+
+/*
+ * mmap(2) layout: this header in the first page, then two buffers at the
+ * given byte offsets.  Each holds the grid bit-packed, "words" u32 words per
+ * row with bit j of word k holding column 32 * k + j, and "front" is the one
+ * holding the current generation.  seq is odd while the kernel updates the
+ * header or the front buffer; a copy of the front buffer taken between two
+ * reads of the same even seq is consistent.  GOL_GEOMETRY fails with EBUSY
+ * while the grid is mapped.
+ */
+struct gol_shared {
+	__u32 seq;
+	__u32 front;
+	__u32 rows;
+	__u32 columns;
+	__u32 words;
+	__u32 reserved;
+	__u64 generation;
+	__u64 offset[2];
+};
+
+/* Default grid size, GOL_GEOMETRY changes it per open file */
 #define ROWS (16)
 #define COLUMNS (32)
 
+#define GOL_MAX_ROWS (4096)
+#define GOL_MAX_COLUMNS (4096)
+
 #define HEIGHT (ROWS + 2)
 #define WIDTH (COLUMNS + 2 + 1)
 
@@ -33,5 +222,9 @@
 #define DEVPATH "/dev/" DEVNAME
 
 #define GRID_STRING_SIZE (HEIGHT * WIDTH + 1)
+#define GOL_GRID_STRING_SIZE(rows, cols) (((rows) + 2) * ((cols) + 3) + 1)
+#define GOL_BITMAP_SIZE(rows, cols) ((rows) * (((cols) + 7) / 8))
+#define GOL_DIFF_RECORD_SIZE(cols) (4 * (1 + ((cols) + 31) / 32))
+#define GOL_DIFF_SIZE(rows, cols) ((rows) * GOL_DIFF_RECORD_SIZE(cols))
 
 #endif  // GAME_OF_LIFE_H
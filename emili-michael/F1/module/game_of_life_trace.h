@@ -0,0 +1,159 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM game_of_life
+
+#if !defined(GAME_OF_LIFE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define GAME_OF_LIFE_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * Boards are named by the thread that opened them, like in debugfs.  A tick
+ * covers @count generations, more than one with the Hashlife engine.
+ */
+TRACE_EVENT(gol_tick_start,
+
+	TP_PROTO(pid_t owner, u64 generation, u64 count),
+
+	TP_ARGS(owner, generation, count),
+
+	TP_STRUCT__entry(
+		__field(pid_t, owner)
+		__field(u64, generation)
+		__field(u64, count)
+	),
+
+	TP_fast_assign(
+		__entry->owner = owner;
+		__entry->generation = generation;
+		__entry->count = count;
+	),
+
+	TP_printk("board=%d generation=%llu count=%llu", __entry->owner,
+		  __entry->generation, __entry->count)
+);
+
+/* @born and @died are only counted while this event is enabled. */
+TRACE_EVENT(gol_tick_end,
+
+	TP_PROTO(pid_t owner, u64 generation, u64 duration_ns, u64 born,
+		 u64 died),
+
+	TP_ARGS(owner, generation, duration_ns, born, died),
+
+	TP_STRUCT__entry(
+		__field(pid_t, owner)
+		__field(u64, generation)
+		__field(u64, duration_ns)
+		__field(u64, born)
+		__field(u64, died)
+	),
+
+	TP_fast_assign(
+		__entry->owner = owner;
+		__entry->generation = generation;
+		__entry->duration_ns = duration_ns;
+		__entry->born = born;
+		__entry->died = died;
+	),
+
+	TP_printk("board=%d generation=%llu duration=%lluns born=%llu died=%llu",
+		  __entry->owner, __entry->generation, __entry->duration_ns,
+		  __entry->born, __entry->died)
+);
+
+TRACE_EVENT(gol_read,
+
+	TP_PROTO(pid_t owner, int format, size_t bytes),
+
+	TP_ARGS(owner, format, bytes),
+
+	TP_STRUCT__entry(
+		__field(pid_t, owner)
+		__field(int, format)
+		__field(size_t, bytes)
+	),
+
+	TP_fast_assign(
+		__entry->owner = owner;
+		__entry->format = format;
+		__entry->bytes = bytes;
+	),
+
+	TP_printk("board=%d format=%d bytes=%zu", __entry->owner,
+		  __entry->format, __entry->bytes)
+);
+
+TRACE_EVENT(gol_write,
+
+	TP_PROTO(pid_t owner, loff_t pos, size_t count),
+
+	TP_ARGS(owner, pos, count),
+
+	TP_STRUCT__entry(
+		__field(pid_t, owner)
+		__field(loff_t, pos)
+		__field(size_t, count)
+	),
+
+	TP_fast_assign(
+		__entry->owner = owner;
+		__entry->pos = pos;
+		__entry->count = count;
+	),
+
+	TP_printk("board=%d pos=%lld count=%zu", __entry->owner,
+		  __entry->pos, __entry->count)
+);
+
+TRACE_EVENT(gol_llseek,
+
+	TP_PROTO(pid_t owner, loff_t offset, int whence),
+
+	TP_ARGS(owner, offset, whence),
+
+	TP_STRUCT__entry(
+		__field(pid_t, owner)
+		__field(loff_t, offset)
+		__field(int, whence)
+	),
+
+	TP_fast_assign(
+		__entry->owner = owner;
+		__entry->offset = offset;
+		__entry->whence = whence;
+	),
+
+	TP_printk("board=%d offset=%lld whence=%d", __entry->owner,
+		  __entry->offset, __entry->whence)
+);
+
+TRACE_EVENT(gol_ioctl,
+
+	TP_PROTO(pid_t owner, unsigned int cmd, unsigned long arg),
+
+	TP_ARGS(owner, cmd, arg),
+
+	TP_STRUCT__entry(
+		__field(pid_t, owner)
+		__field(unsigned int, cmd)
+		__field(unsigned long, arg)
+	),
+
+	TP_fast_assign(
+		__entry->owner = owner;
+		__entry->cmd = cmd;
+		__entry->arg = arg;
+	),
+
+	TP_printk("board=%d cmd=%#x arg=%#lx", __entry->owner, __entry->cmd,
+		  __entry->arg)
+);
+
+#endif /* GAME_OF_LIFE_TRACE_H */
+
+/* This part must be outside the include guard */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE game_of_life_trace
+#include <trace/define_trace.h>
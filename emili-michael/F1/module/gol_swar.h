@@ -0,0 +1,132 @@
+#ifndef GOL_SWAR_H
+#define GOL_SWAR_H
+
+/*
+ * The bit-sliced tick, shared by the module and the userspace library in
+ * life.c.  Rows are bit-packed like the mmap(2) buffers: bit j of word k
+ * holds column 32 * k + j, and bits past the last column are clear.
+ * Rules are masks of neighbor counts, bit n of @birth (@survive) is set
+ * when a dead (live) cell with n live neighbors lives on.
+ */
+
+#include <linux/types.h>
+
+#define GOL_CONWAY_BIRTH (1U << 3)
+#define GOL_CONWAY_SURVIVE ((1U << 2) | (1U << 3))
+
+/*
+ * Bit-sliced full adder: adds three one-bit lanes per bit position, leaving
+ * the low bit of each sum in *sum and the carry in *carry.
+ */
+static inline void gol_add3(__u32 a, __u32 b, __u32 c, __u32 *sum,
+			    __u32 *carry)
+{
+	__u32 t = a ^ b;
+
+	*sum = t ^ c;
+	*carry = (a & b) | (t & c);
+}
+
+/*
+ * Lanes whose neighbor count, in the bit planes n0..n3, is one of the counts
+ * set in @counts.  Every count is compared, so there is no branch on the
+ * rule.
+ */
+static inline __u32 gol_count_lanes(__u32 n0, __u32 n1, __u32 n2, __u32 n3,
+				    __u16 counts)
+{
+	__u32 lanes = 0;
+
+	for (unsigned int c = 0; c <= 8; ++c) {
+		__u32 eq = (c & 1 ? n0 : ~n0) & (c & 2 ? n1 : ~n1) &
+			   (c & 4 ? n2 : ~n2) & (c & 8 ? n3 : ~n3);
+
+		lanes |= eq & -(__u32)((counts >> c) & 1);
+	}
+	return lanes;
+}
+
+/*
+ * Next generation of the 32 cells in @mid given the words holding their
+ * west and east neighbors (the _w and _e lanes) and the words above and
+ * below.  The eight neighbor counts are summed in parallel into the bit
+ * planes n0..n3 (weights 1, 2, 4 and 8).  B3/S23 has a shortcut, any
+ * other rule compares the counts with its births and survivals.
+ */
+static inline __u32 gol_next_word(__u32 up_w, __u32 up, __u32 up_e,
+				  __u32 mid_w, __u32 mid, __u32 mid_e,
+				  __u32 down_w, __u32 down, __u32 down_e,
+				  __u16 birth, __u16 survive)
+{
+	__u32 s_up, c_up, s_mid, c_mid, s_down, c_down;
+	__u32 n0, n1, n2, n3, carry1, carry2, carry4;
+
+	gol_add3(up_w, up, up_e, &s_up, &c_up);
+	s_mid = mid_w ^ mid_e;
+	c_mid = mid_w & mid_e;
+	gol_add3(down_w, down, down_e, &s_down, &c_down);
+
+	gol_add3(s_up, s_mid, s_down, &n0, &carry1);
+	gol_add3(c_up, c_mid, c_down, &n1, &carry2);
+	carry4 = n1 & carry1;
+	n1 ^= carry1;
+	n2 = carry2 ^ carry4;
+	n3 = carry2 & carry4;
+
+	// Alive with 3 neighbors, or with 2 neighbors if it was already alive.
+	if (birth == GOL_CONWAY_BIRTH && survive == GOL_CONWAY_SURVIVE)
+		return ~n3 & ~n2 & n1 & (n0 | mid);
+
+	return (~mid & gol_count_lanes(n0, n1, n2, n3, birth)) |
+	       (mid & gol_count_lanes(n0, n1, n2, n3, survive));
+}
+
+/*
+ * Word @k of the west (east) neighbor lane of @row: bit c holds column c - 1
+ * (c + 1).  @edge is the bit of the last column in the last word, which wraps
+ * around to column 0 and back.  With a single full word these are rotates.
+ */
+static inline __u32 gol_west_lane(const __u32 *row, unsigned int k,
+				  unsigned int last, unsigned int edge)
+{
+	__u32 carry = k ? row[k - 1] >> 31 : (row[last] >> edge) & 1;
+
+	return (row[k] << 1) | carry;
+}
+
+static inline __u32 gol_east_lane(const __u32 *row, unsigned int k,
+				  unsigned int last, unsigned int edge)
+{
+	if (k < last)
+		return (row[k] >> 1) | (row[k + 1] << 31);
+	return (row[k] >> 1) | ((row[0] & 1) << edge);
+}
+
+/*
+ * Next generation of a row of @cols cells from the rows above and below.
+ * Words whose tile is not @active are left as they are, NULL means all.
+ */
+static inline void gol_next_row(const __u32 *up, const __u32 *mid,
+				const __u32 *down, __u32 *out, unsigned int cols,
+				const __u8 *active, __u16 birth, __u16 survive)
+{
+	unsigned int last = (cols - 1) / 32;
+	unsigned int edge = (cols - 1) % 32;
+
+	for (unsigned int k = 0; k <= last; ++k) {
+		if (active && !active[k])
+			continue;
+		out[k] = gol_next_word(gol_west_lane(up, k, last, edge), up[k],
+				       gol_east_lane(up, k, last, edge),
+				       gol_west_lane(mid, k, last, edge), mid[k],
+				       gol_east_lane(mid, k, last, edge),
+				       gol_west_lane(down, k, last, edge), down[k],
+				       gol_east_lane(down, k, last, edge),
+				       birth, survive);
+	}
+
+	// The west lane shifts the last column into the padding bits.
+	out[last] &= ~0U >> (31 - edge);
+}
+
+#endif  // GOL_SWAR_H
@@ -0,0 +1,163 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gol_swar.h"
+#include "life.h"
+
+static __u32 *row(const struct life *life, __u32 *board, unsigned int r)
+{
+	return board + (size_t)r * life->words;
+}
+
+static void swap_boards(struct life *life)
+{
+	__u32 *tmp = life->board;
+
+	life->board = life->back;
+	life->back = tmp;
+	++life->generation;
+}
+
+int life_init(struct life *life, unsigned int rows, unsigned int cols)
+{
+	if (!rows || !cols) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	*life = (struct life){ .rows = rows, .cols = cols,
+			       .words = (cols + 31) / 32,
+			       .birth = GOL_CONWAY_BIRTH,
+			       .survive = GOL_CONWAY_SURVIVE };
+
+	size_t size = (size_t)rows * life->words;
+
+	life->board = calloc(size, sizeof(__u32));
+	life->back = calloc(size, sizeof(__u32));
+	if (!life->board || !life->back) {
+		life_free(life);
+		errno = ENOMEM;
+		return -1;
+	}
+	return 0;
+}
+
+void life_free(struct life *life)
+{
+	free(life->board);
+	free(life->back);
+	life->board = NULL;
+	life->back = NULL;
+}
+
+int life_set_rule(struct life *life, const char *rule)
+{
+	__u16 birth = 0, survive = 0;
+	__u16 *set = &birth;
+
+	if (*rule != 'B' && *rule != 'b')
+		return -1;
+
+	for (const char *p = rule + 1; *p; ++p) {
+		if ('0' <= *p && *p <= '8') {
+			*set |= 1U << (*p - '0');
+		} else if (set == &birth && *p == '/' &&
+			   (p[1] == 'S' || p[1] == 's')) {
+			set = &survive;
+			++p;
+		} else {
+			return -1;
+		}
+	}
+	if (set != &survive)
+		return -1;
+
+	life->birth = birth;
+	life->survive = survive;
+	return 0;
+}
+
+int life_cell(const struct life *life, unsigned int r, unsigned int c)
+{
+	return row(life, life->board, r)[c / 32] >> (c % 32) & 1;
+}
+
+void life_set_cell(struct life *life, unsigned int r, unsigned int c,
+		   int alive)
+{
+	__u32 *word = &row(life, life->board, r)[c / 32];
+
+	if (alive)
+		*word |= 1U << (c % 32);
+	else
+		*word &= ~(1U << (c % 32));
+}
+
+void life_load_bitmap(struct life *life, const unsigned char *bitmap)
+{
+	unsigned int stride = (life->cols + 7) / 8;
+
+	for (unsigned int r = 0; r < life->rows; ++r)
+		for (unsigned int c = 0; c < life->cols; ++c)
+			life_set_cell(life, r, c,
+				      bitmap[r * stride + c / 8] >> (c % 8) & 1);
+}
+
+void life_store_bitmap(const struct life *life, unsigned char *bitmap)
+{
+	unsigned int stride = (life->cols + 7) / 8;
+
+	memset(bitmap, 0, (size_t)life->rows * stride);
+	for (unsigned int r = 0; r < life->rows; ++r)
+		for (unsigned int c = 0; c < life->cols; ++c)
+			bitmap[r * stride + c / 8] |=
+				life_cell(life, r, c) << (c % 8);
+}
+
+void life_tick(struct life *life)
+{
+	for (unsigned int r = 0; r < life->rows; ++r) {
+		unsigned int up = r ? r - 1 : life->rows - 1;
+		unsigned int down = r + 1 < life->rows ? r + 1 : 0;
+
+		gol_next_row(row(life, life->board, up),
+			     row(life, life->board, r),
+			     row(life, life->board, down),
+			     row(life, life->back, r), life->cols, NULL,
+			     life->birth, life->survive);
+	}
+	swap_boards(life);
+}
+
+/*
+ * Shares nothing with the module but the grid layout, so that it can
+ * catch a mistake in gol_swar.h as well as in the device.
+ */
+void life_tick_reference(struct life *life)
+{
+	for (unsigned int r = 0; r < life->rows; ++r) {
+		memset(row(life, life->back, r), 0, life->words * sizeof(__u32));
+
+		for (unsigned int c = 0; c < life->cols; ++c) {
+			unsigned int n = 0;
+
+			for (int dr = -1; dr <= 1; ++dr) {
+				for (int dc = -1; dc <= 1; ++dc) {
+					if (!dr && !dc)
+						continue;
+					n += life_cell(life,
+						       (r + life->rows + dr) % life->rows,
+						       (c + life->cols + dc) % life->cols);
+				}
+			}
+
+			__u16 counts = life_cell(life, r, c) ? life->survive :
+								 life->birth;
+
+			if (counts >> n & 1)
+				row(life, life->back, r)[c / 32] |= 1U << (c % 32);
+		}
+	}
+	swap_boards(life);
+}
@@ -0,0 +1,46 @@
+#ifndef LIFE_H
+#define LIFE_H
+
+#include <linux/types.h>
+
+/*
+ *  <----! Game of Life engines in userspace (liblife.a) ---->
+ *
+ *	  The tick logic of the module built for userspace, to check the
+ *	  device against and to time it.  Grids wrap around like the module's
+ *	  and are bit-packed like its mmap(2) buffers.
+ *
+ *	  life_tick() - next generation with the module's SWAR engine
+ *	  life_tick_reference() - next generation counted cell by cell
+ */
+
+struct life {
+	unsigned int rows;
+	unsigned int cols;
+	unsigned int words;	/* per row */
+	__u16 birth;		/* neighbor counts, as in gol_swar.h */
+	__u16 survive;
+	__u32 *board;
+	__u32 *back;
+	__u64 generation;
+};
+
+/* Empty B3/S23 grid, returns 0 or -1 with errno set */
+int life_init(struct life *life, unsigned int rows, unsigned int cols);
+void life_free(struct life *life);
+
+/* B/S notation as taken by GOL_RULE, returns 0 or -1 if invalid */
+int life_set_rule(struct life *life, const char *rule);
+
+/* GOL_FORMAT_BITMAP layout, GOL_BITMAP_SIZE(rows, cols) bytes */
+void life_load_bitmap(struct life *life, const unsigned char *bitmap);
+void life_store_bitmap(const struct life *life, unsigned char *bitmap);
+
+int life_cell(const struct life *life, unsigned int row, unsigned int col);
+void life_set_cell(struct life *life, unsigned int row, unsigned int col,
+		   int alive);
+
+void life_tick(struct life *life);
+void life_tick_reference(struct life *life);
+
+#endif  // LIFE_H
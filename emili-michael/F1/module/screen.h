@@ -28,12 +28,6 @@ static void show_cursor(void) { printf("\033[?25h"); }
 
 static void clear_screen(void) { printf("\033[2J"); }
 
-static void render_screen(void)
-{
-	fflush(stdout);
-	usleep(50000);
-}
-
 static void enable_raw_mode(struct termios *old_tio)
 {
 	struct termios new_tio;
@@ -1,15 +1,92 @@
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #define GOL_MAGIC ('g')
 #define GOL_TICK _IO(GOL_MAGIC, 0x01)
 #define GOL_LIVE _IOW(GOL_MAGIC, 0x02, char)
 #define GOL_ERROR _IO(GOL_MAGIC, 0x03)
+#define GOL_TICK_N _IOWR(GOL_MAGIC, 0x03, unsigned long long)
+#define GOL_CYCLE _IOR(GOL_MAGIC, 0x04, struct gol_cycle_info)
+
+struct gol_cycle_info {
+	unsigned long long generation;
+	unsigned long long period;
+	unsigned long long start;
+};
+
+#define GOL_GEOMETRY _IOW(GOL_MAGIC, 0x05, struct gol_geometry)
+
+struct gol_geometry {
+	unsigned int rows;
+	unsigned int columns;
+};
+
+#define GOL_FORMAT _IOW(GOL_MAGIC, 0x06, int)
+#define GOL_FORMAT_BITMAP (1)
+#define GOL_FORMAT_RLE (2)
+#define GOL_FORMAT_DIFF (3)
+
+#define GOL_LOAD _IOW(GOL_MAGIC, 0x07, int)
+#define GOL_LOAD_RLE (2)
+#define GOL_LOAD_LIFE106 (3)
+
+#define GOL_OBSERVE _IOW(GOL_MAGIC, 0x08, int)
+#define GOL_WAIT _IOW(GOL_MAGIC, 0x09, int)
+#define GOL_RUN _IOW(GOL_MAGIC, 0x0a, int)
+#define GOL_PAUSE _IO(GOL_MAGIC, 0x0b)
+#define GOL_STEP _IO(GOL_MAGIC, 0x0c)
+#define GOL_RUN_STATS _IOR(GOL_MAGIC, 0x0d, struct gol_run_stats)
+
+struct gol_run_stats {
+	unsigned int rate;
+	unsigned int reserved;
+	unsigned long long generations;
+	unsigned long long overruns;
+	unsigned long long late_avg_ns;
+	unsigned long long late_max_ns;
+};
+
+#define GOL_TILE_STATS _IOR(GOL_MAGIC, 0x0e, struct gol_tile_stats)
+
+struct gol_tile_stats {
+	unsigned int tiles;
+	unsigned int last;
+	unsigned long long generations;
+	unsigned long long evaluated;
+};
+
+#define GOL_RULE _IOW(GOL_MAGIC, 0x0f, struct gol_rule)
+
+struct gol_rule {
+	char rule[32];
+};
+
+#define GOL_HISTORY _IOW(GOL_MAGIC, 0x10, int)
+#define GOL_REWIND _IOW(GOL_MAGIC, 0x11, int)
+#define GOL_GENERATION _IOW(GOL_MAGIC, 0x12, struct gol_generation)
+
+struct gol_generation {
+	unsigned long long generation;
+	unsigned long long bitmap;
+};
+
+struct gol_shared {
+	unsigned int seq;
+	unsigned int front;
+	unsigned int rows;
+	unsigned int columns;
+	unsigned int words;
+	unsigned int reserved;
+	unsigned long long generation;
+	unsigned long long offset[2];
+};
 
 #define SPONGEBOB 32
 // Each row has 32 cells + 2 walls + new line
@@ -338,7 +415,7 @@
 
 #define FILE_PATH "/dev/game_of_life"
 // #define FILE_PATH "/dev/null"
-#define TESTS_NUM 28
+#define TESTS_NUM 44
 
 void print_tests_num(int num) { printf("1..%d\n", num); }
 
@@ -848,6 +925,572 @@ bool test_oscillating_structure(void)
 	return result;
 }
 
+bool test_multi_generation_tick(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	char buf[GRID_STRING_SIZE];
+	unsigned long long generations = 5;
+
+	lseek(fd, 32, SEEK_SET);
+	write(fd, NULL, 0);
+	write(fd, NULL, 0);
+	write(fd, NULL, 0);
+
+	bool result = ioctl(fd, GOL_TICK_N, &generations) == 0;
+
+	result = result && (generations == 5);
+
+	read(fd, buf, 0);
+	result = result && (strcmp(buf, GRID_BLINKER_2) == 0);
+
+	close(fd);
+	return result;
+}
+
+bool test_period_detection(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	char buf[GRID_STRING_SIZE];
+	unsigned long long generations = 1000000001ULL;
+	struct gol_cycle_info cycle;
+
+	lseek(fd, 32, SEEK_SET);
+	write(fd, NULL, 0);
+	write(fd, NULL, 0);
+	write(fd, NULL, 0);
+
+	bool result = ioctl(fd, GOL_TICK_N, &generations) == 0;
+
+	result = result && (generations == 1000000001ULL);
+
+	read(fd, buf, 0);
+	result = result && (strcmp(buf, GRID_BLINKER_2) == 0);
+
+	result = result && ioctl(fd, GOL_CYCLE, &cycle) == 0;
+	result = result && cycle.period == 2 && cycle.start == 0;
+	result = result && cycle.generation == 1000000001ULL;
+
+	close(fd);
+	return result;
+}
+
+bool test_custom_geometry(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	char buf[GRID_STRING_SIZE];
+	struct gol_geometry geometry = { .rows = 3, .columns = 4 };
+
+	bool result = ioctl(fd, GOL_GEOMETRY, &geometry) == 0;
+
+	lseek(fd, 11, SEEK_SET);
+	write(fd, NULL, 0);
+	read(fd, buf, 0);
+	result = result && strcmp(buf, "------\n"
+					"|    |\n"
+					"|    |\n"
+					"|   *|\n"
+					"------\n") == 0;
+
+	result = result && read(fd, buf, 10) < 0 && errno == EINVAL;
+
+	lseek(fd, 12, SEEK_SET);
+	result = result && (errno == EPERM);
+
+	close(fd);
+	return result;
+}
+
+bool test_bitmap_read(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	unsigned char buf[16 * SPONGEBOB / 8];
+	unsigned char expected[16 * SPONGEBOB / 8] = { 0 };
+	int cells[] = { 0, 9, 33, 511 };
+
+	for (int i = 0; i < 4; ++i) {
+		lseek(fd, cells[i], SEEK_SET);
+		write(fd, NULL, 0);
+		expected[cells[i] / 8] |= 1 << (cells[i] % 8);
+	}
+
+	bool result = ioctl(fd, GOL_FORMAT, GOL_FORMAT_BITMAP) == 0;
+
+	result = result && read(fd, buf, sizeof(buf)) == sizeof(buf) &&
+		 memcmp(buf, expected, sizeof(buf)) == 0;
+	result = result && read(fd, buf, sizeof(buf) - 1) < 0 && errno == EINVAL;
+
+	close(fd);
+	return result;
+}
+
+bool test_rle_read(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	const char expected[] = "x = 5, y = 5, rule = B3/S23\nbo$2bo$3o!\n";
+	char buf[64];
+	struct gol_geometry geometry = { .rows = 5, .columns = 5 };
+	int glider[] = { 1, 7, 10, 11, 12 };
+
+	bool result = ioctl(fd, GOL_GEOMETRY, &geometry) == 0 &&
+		      ioctl(fd, GOL_FORMAT, GOL_FORMAT_RLE) == 0;
+
+	for (int i = 0; i < 5; ++i) {
+		lseek(fd, glider[i], SEEK_SET);
+		write(fd, NULL, 0);
+	}
+
+	result = result && read(fd, buf, sizeof(buf)) == strlen(expected) &&
+		 strncmp(buf, expected, strlen(expected)) == 0;
+	result = result && read(fd, buf, 10) < 0 && errno == EINVAL;
+
+	close(fd);
+	return result;
+}
+
+bool test_diff_read(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	// Records are the row index, then the row's only word.
+	unsigned int buf[16 * 2];
+	unsigned int vertical[] = { 4, 1 << 11, 5, 1 << 11, 6, 1 << 11 };
+
+	for (int i = 5 * SPONGEBOB + 10; i <= 5 * SPONGEBOB + 12; ++i) {
+		lseek(fd, i, SEEK_SET);
+		write(fd, NULL, 0);
+	}
+
+	bool result = ioctl(fd, GOL_FORMAT, GOL_FORMAT_DIFF) == 0;
+
+	result = result && read(fd, buf, sizeof(buf) - 1) < 0 && errno == EINVAL;
+
+	// Every row is new on the first read, none on the next.
+	result = result && read(fd, buf, sizeof(buf)) == sizeof(buf) &&
+		 buf[10] == 5 && buf[11] == 7 << 10;
+	result = result && read(fd, buf, sizeof(buf)) == 0;
+
+	ioctl(fd, GOL_TICK);
+	result = result && read(fd, buf, sizeof(buf)) == sizeof(vertical) &&
+		 memcmp(buf, vertical, sizeof(vertical)) == 0;
+
+	close(fd);
+	return result;
+}
+
+bool test_rle_load(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	const char pattern[] = "#N Glider\nx = 3, y = 3, rule = B3/S23\nbo$2bo$3o!\n";
+	char buf[64];
+	struct gol_geometry geometry = { .rows = 3, .columns = 4 };
+
+	bool result = ioctl(fd, GOL_GEOMETRY, &geometry) == 0;
+
+	// Start from a board the load has to clear.
+	lseek(fd, 3, SEEK_SET);
+	write(fd, NULL, 0);
+
+	result = result && ioctl(fd, GOL_LOAD, GOL_LOAD_RLE) == 0;
+	result = result && write(fd, pattern, strlen(pattern)) == strlen(pattern);
+	read(fd, buf, 0);
+	result = result && strcmp(buf, "------\n"
+					"| *  |\n"
+					"|  * |\n"
+					"|*** |\n"
+					"------\n") == 0;
+
+	// A pattern that does not fit leaves the board alone.
+	result = result && write(fd, "x = 5, y = 1\n5o!", 16) < 0 && errno == EINVAL;
+	read(fd, buf, 0);
+	result = result && buf[9] == '*';
+
+	close(fd);
+	return result;
+}
+
+bool test_life106_load(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	const char pattern[] = "#Life 1.06\n0 0\n-1 -1\n";
+	char buf[64];
+	struct gol_geometry geometry = { .rows = 3, .columns = 4 };
+
+	bool result = ioctl(fd, GOL_GEOMETRY, &geometry) == 0 &&
+		      ioctl(fd, GOL_LOAD, GOL_LOAD_LIFE106) == 0;
+
+	result = result && write(fd, pattern, strlen(pattern)) == strlen(pattern);
+	read(fd, buf, 0);
+	result = result && strcmp(buf, "------\n"
+					"|*   |\n"
+					"|    |\n"
+					"|   *|\n"
+					"------\n") == 0;
+
+	close(fd);
+	return result;
+}
+
+bool test_failed_load_keeps_still_life(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	// Rows of 6 bytes, the block in bits 0 and 1 of byte 5 of rows 40, 41.
+	// Not a power of two, so the tiles tick it rather than Hashlife.
+	unsigned char bitmap[48 * 6];
+	struct gol_geometry geometry = { .rows = 48, .columns = 48 };
+
+	bool result = ioctl(fd, GOL_GEOMETRY, &geometry) == 0;
+
+	for (int i = 40; i <= 41; ++i) {
+		for (int j = 40; j <= 41; ++j) {
+			lseek(fd, i * 48 + j, SEEK_SET);
+			write(fd, NULL, 0);
+		}
+	}
+	// A blinker far from the block keeps the buffers swapping.
+	for (int j = 4; j <= 6; ++j) {
+		lseek(fd, 20 * 48 + j, SEEK_SET);
+		write(fd, NULL, 0);
+	}
+
+	// Once still, the block's tile is no longer evaluated.
+	ioctl(fd, GOL_TICK);
+	result = result && ioctl(fd, GOL_LOAD, GOL_LOAD_RLE) == 0 &&
+		 write(fd, "x = 3, y = 1\n5o!", 16) < 0 && errno == EINVAL;
+	ioctl(fd, GOL_TICK);
+
+	result = result && ioctl(fd, GOL_FORMAT, GOL_FORMAT_BITMAP) == 0 &&
+		 read(fd, bitmap, sizeof(bitmap)) == sizeof(bitmap) &&
+		 bitmap[40 * 6 + 5] == 3 && bitmap[41 * 6 + 5] == 3;
+
+	close(fd);
+	return result;
+}
+
+bool test_mmap_board(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	size_t size = 3 * sysconf(_SC_PAGESIZE);
+	const struct gol_shared *shared = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+
+	if (shared == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	// A blinker in the middle of the first row.
+	for (int i = 15; i <= 17; ++i) {
+		lseek(fd, i, SEEK_SET);
+		write(fd, NULL, 0);
+	}
+	ioctl(fd, GOL_TICK);
+
+	const char *front = (const char *)shared + shared->offset[shared->front];
+	const unsigned int *board = (const unsigned int *)front;
+	unsigned int column = 1 << 16;
+
+	bool result = shared->rows == 16 && shared->columns == 32 &&
+		      shared->words == 1 && shared->seq % 2 == 0 &&
+		      shared->generation == 1;
+
+	result = result && board[0] == column && board[1] == column &&
+		 board[15] == column;
+
+	// The mapping is read-only and pins the geometry.
+	struct gol_geometry geometry = { .rows = 3, .columns = 4 };
+
+	result = result && ioctl(fd, GOL_GEOMETRY, &geometry) < 0 && errno == EBUSY;
+	result = result && mmap(NULL, size, PROT_WRITE, MAP_SHARED, fd, 0) == MAP_FAILED;
+
+	munmap((void *)shared, size);
+	result = result && ioctl(fd, GOL_GEOMETRY, &geometry) == 0;
+
+	close(fd);
+	return result;
+}
+
+static int poll_revents(int fd)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	return poll(&pfd, 1, 0) == 1 ? pfd.revents : 0;
+}
+
+bool test_observe_and_wait(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	char buf[GRID_STRING_SIZE + 1];
+	int observer = ioctl(fd, GOL_OBSERVE, getpid());
+
+	bool result = observer >= 0 && ioctl(observer, GOL_WAIT, 1) == 0;
+
+	// A new observer has not read the current frame yet.
+	result = result && poll_revents(observer) == POLLIN;
+	result = result && read(observer, buf, 0) > 0;
+	result = result && poll_revents(observer) == 0;
+
+	fcntl(observer, F_SETFL, O_NONBLOCK);
+	result = result && read(observer, buf, 0) < 0 && errno == EAGAIN;
+
+	// Observers cannot change the board.
+	result = result && ioctl(observer, GOL_TICK) < 0 && errno == EPERM;
+
+	ioctl(fd, GOL_TICK);
+	result = result && poll_revents(observer) == POLLIN;
+	result = result && read(observer, buf, 0) > 0;
+
+	close(fd);
+	result = result && (poll_revents(observer) & POLLHUP);
+	result = result && read(observer, buf, 0) == 0;
+
+	close(observer);
+	return result;
+}
+
+bool test_diff_wait_skips_still_frames(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	unsigned int buf[16 * 2];
+	int block[] = { SPONGEBOB + 1, SPONGEBOB + 2, 2 * SPONGEBOB + 1,
+			2 * SPONGEBOB + 2 };
+
+	for (int i = 0; i < 4; ++i) {
+		lseek(fd, block[i], SEEK_SET);
+		write(fd, NULL, 0);
+	}
+
+	int observer = ioctl(fd, GOL_OBSERVE, getpid());
+
+	bool result = observer >= 0 && ioctl(observer, GOL_WAIT, 1) == 0 &&
+		      ioctl(observer, GOL_FORMAT, GOL_FORMAT_DIFF) == 0;
+
+	fcntl(observer, F_SETFL, O_NONBLOCK);
+	result = result && read(observer, buf, sizeof(buf)) == sizeof(buf);
+
+	// A still life and a new live character change no row.
+	ioctl(fd, GOL_TICK);
+	ioctl(fd, GOL_LIVE, '#');
+	result = result && poll_revents(observer) == 0;
+	result = result && read(observer, buf, sizeof(buf)) < 0 &&
+		 errno == EAGAIN;
+
+	lseek(fd, 10 * SPONGEBOB + 20, SEEK_SET);
+	write(fd, NULL, 0);
+	result = result && poll_revents(observer) == POLLIN;
+	result = result && read(observer, buf, sizeof(buf)) == 2 * sizeof(*buf) &&
+		 buf[0] == 10 && buf[1] == 1 << 20;
+
+	close(fd);
+	result = result && read(observer, buf, sizeof(buf)) == 0;
+
+	close(observer);
+	return result;
+}
+
+bool test_run_pause_step(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	struct gol_run_stats stats;
+	struct gol_cycle_info before, after;
+
+	bool result = ioctl(fd, GOL_RUN, 0) < 0 && errno == EINVAL;
+
+	result = result && ioctl(fd, GOL_RUN, 1000) == 0;
+	usleep(100000);
+	result = result && ioctl(fd, GOL_PAUSE) == 0;
+
+	result = result && ioctl(fd, GOL_RUN_STATS, &stats) == 0 &&
+		 stats.rate == 0 && stats.generations > 0 &&
+		 ioctl(fd, GOL_CYCLE, &before) == 0 &&
+		 before.generation == stats.generations;
+
+	// Paused, only a step moves the board on.
+	usleep(20000);
+	ioctl(fd, GOL_STEP);
+	result = result && ioctl(fd, GOL_CYCLE, &after) == 0 &&
+		 after.generation == before.generation + 1;
+
+	close(fd);
+	return result;
+}
+
+bool test_active_tiles(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	// 8 rows of 4 tiles, a blinker in tile (2, 1).
+	unsigned char buf[64 * 128 / 8];
+	struct gol_geometry geometry = { .rows = 64, .columns = 128 };
+	struct gol_tile_stats stats;
+
+	bool result = ioctl(fd, GOL_GEOMETRY, &geometry) == 0;
+
+	for (int i = 21 * 128 + 40; i <= 21 * 128 + 42; ++i) {
+		lseek(fd, i, SEEK_SET);
+		write(fd, NULL, 0);
+	}
+
+	// The first generation evaluates every tile, the next only the
+	// blinker's tile and its neighbors.
+	ioctl(fd, GOL_TICK);
+	result = result && ioctl(fd, GOL_TILE_STATS, &stats) == 0 &&
+		 stats.tiles == 32 && stats.last == 32;
+	ioctl(fd, GOL_TICK);
+	result = result && ioctl(fd, GOL_TILE_STATS, &stats) == 0 &&
+		 stats.last == 9 && stats.generations == 2 &&
+		 stats.evaluated == 41;
+
+	result = result && ioctl(fd, GOL_FORMAT, GOL_FORMAT_BITMAP) == 0 &&
+		 read(fd, buf, sizeof(buf)) == sizeof(buf) &&
+		 buf[21 * 16 + 5] == 0x07 && buf[20 * 16 + 5] == 0;
+
+	close(fd);
+	return result;
+}
+
+bool test_rule(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	const char expected[] = "x = 5, y = 5, rule = B2/S\n$b2o2$b2o!\n";
+	const char *invalid[] = { "B9/S23", "X3/S23", "B3S23", "B3/S23/" };
+	char buf[64];
+	struct gol_geometry geometry = { .rows = 5, .columns = 5 };
+	struct gol_rule rule;
+	bool result = ioctl(fd, GOL_GEOMETRY, &geometry) == 0;
+
+	for (int i = 0; i < 4; ++i) {
+		strcpy(rule.rule, invalid[i]);
+		result = result && ioctl(fd, GOL_RULE, &rule) < 0 && errno == EINVAL;
+	}
+
+	// Under Seeds every cell dies and a pair gives birth on both sides.
+	strcpy(rule.rule, "b2/s");
+	result = result && ioctl(fd, GOL_RULE, &rule) == 0;
+
+	lseek(fd, 11, SEEK_SET);
+	write(fd, NULL, 0);
+	lseek(fd, 12, SEEK_SET);
+	write(fd, NULL, 0);
+	ioctl(fd, GOL_TICK);
+
+	result = result && ioctl(fd, GOL_FORMAT, GOL_FORMAT_RLE) == 0 &&
+		 read(fd, buf, sizeof(buf)) == strlen(expected) &&
+		 strncmp(buf, expected, strlen(expected)) == 0;
+
+	close(fd);
+	return result;
+}
+
+bool test_history_rewind(void)
+{
+	int fd = open(FILE_PATH, O_RDWR);
+
+	if (fd < 0)
+		return false;
+
+	unsigned char saved[11][16 * SPONGEBOB / 8], buf[16 * SPONGEBOB / 8];
+	struct gol_generation generation = { .bitmap = (unsigned long)buf };
+	struct gol_cycle_info info;
+	int glider[] = { 1, 34, 64, 65, 66 };
+
+	for (int i = 0; i < 5; ++i) {
+		lseek(fd, glider[i], SEEK_SET);
+		write(fd, NULL, 0);
+	}
+
+	bool result = ioctl(fd, GOL_REWIND, 1) < 0 && errno == ENOENT &&
+		      ioctl(fd, GOL_HISTORY, 8) == 0;
+
+	for (int g = 0; g <= 10; ++g) {
+		generation.generation = g;
+		result = result && ioctl(fd, GOL_GENERATION, &generation) == 0;
+		memcpy(saved[g], buf, sizeof(buf));
+		ioctl(fd, GOL_TICK);
+	}
+
+	// Generations 3 to 10 are kept, 11 is the current one.
+	generation.generation = 2;
+	result = result && ioctl(fd, GOL_GENERATION, &generation) < 0 &&
+		 errno == ENOENT;
+	generation.generation = 5;
+	result = result && ioctl(fd, GOL_GENERATION, &generation) == 0 &&
+		 memcmp(buf, saved[5], sizeof(buf)) == 0;
+
+	result = result && ioctl(fd, GOL_REWIND, 4) == 0 &&
+		 ioctl(fd, GOL_CYCLE, &info) == 0 && info.generation == 7;
+	result = result && ioctl(fd, GOL_FORMAT, GOL_FORMAT_BITMAP) == 0 &&
+		 read(fd, buf, sizeof(buf)) == sizeof(buf) &&
+		 memcmp(buf, saved[7], sizeof(buf)) == 0;
+
+	// The generations after the one brought back are gone.
+	generation.generation = 8;
+	result = result && ioctl(fd, GOL_GENERATION, &generation) < 0 &&
+		 errno == ENOENT;
+	ioctl(fd, GOL_TICK);
+	result = result && read(fd, buf, sizeof(buf)) == sizeof(buf) &&
+		 memcmp(buf, saved[8], sizeof(buf)) == 0;
+
+	close(fd);
+	return result;
+}
+
 bool test_modulo_0_0_neighbors(void)
 {
 	int fd = open(FILE_PATH, O_RDWR);
@@ -1073,13 +1716,45 @@ int main(void)
 		     "Large stable structure");
 	print_result(test_oscillating_structure(), test_num++,
 		     "Oscillating structure");
+	print_result(test_multi_generation_tick(), test_num++,
+		     "Multi-generation tick runs all requested generations");
+	print_result(test_period_detection(), test_num++,
+		     "Blinker period is detected and skipped over");
+	print_result(test_custom_geometry(), test_num++,
+		     "Grid of a custom size");
+	print_result(test_bitmap_read(), test_num++,
+		     "Read the grid as a packed bitmap");
+	print_result(test_rle_read(), test_num++,
+		     "Read the grid as RLE");
+	print_result(test_diff_read(), test_num++,
+		     "Read only the rows that changed");
+	print_result(test_rle_load(), test_num++,
+		     "Replace the grid with an RLE pattern");
+	print_result(test_life106_load(), test_num++,
+		     "Replace the grid with a Life 1.06 pattern");
+	print_result(test_failed_load_keeps_still_life(), test_num++,
+		     "A rejected pattern leaves still lifes in place");
+	print_result(test_mmap_board(), test_num++,
+		     "Observe the grid through a read-only mapping");
+	print_result(test_observe_and_wait(), test_num++,
+		     "Observers wait for new generations");
+	print_result(test_diff_wait_skips_still_frames(), test_num++,
+		     "Waiting diff readers skip frames that change no row");
+	print_result(test_run_pause_step(), test_num++,
+		     "Run from a kernel timer, pause and step");
+	print_result(test_active_tiles(), test_num++,
+		     "Ticks skip the tiles that cannot change");
+	print_result(test_rule(), test_num++,
+		     "Tick under another Life-like rule");
+	print_result(test_history_rewind(), test_num++,
+		     "Rewind to a kept generation");
 	print_result(test_modulo_0_0_neighbors(), test_num++,
 		     "Toggle (0,0) and all its neighbors, then tick once");
 	print_result(test_cell_with_2_neighbors_remains_alive_with_modulo(), test_num++,
 		     "Live cell with 2 neighbors remains alive, with modulo");
 	print_result(test_lseek_out_of_range(), test_num++,
-		     "When offset is out of range lseek does not change the current
-		     position and returns an error");
+		     "When offset is out of range lseek does not change the "
+		     "current position and returns an error");
 	print_result(test_lseek_invalid_whence(), test_num++, "Invalid whence");
 	print_result(test_tick_on_empty_grid(), test_num++,
 		     "Empty grid remains empty when ticked");